@@ -0,0 +1,296 @@
+/*  console.cpp
+ *
+ *      Fixed grid text console with per-cell change tracking
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "console.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Construction/Destruction												*/
+/*																			*/
+/****************************************************************************/
+
+/*  TextConsole::TextConsole
+ *
+ *      Construction
+ */
+
+TextConsole::TextConsole(GraphicDisplay &d) : display(d)
+{
+    font = NULL;
+    cols = 0;
+    rows = 0;
+    col = 0;
+    row = 0;
+    attr = TC_NORMAL;
+    cursor = false;
+}
+
+/*  TextConsole::~TextConsole
+ *
+ *      Destruction
+ */
+
+TextConsole::~TextConsole()
+{
+}
+
+/*  TextConsole::start
+ *
+ *      Set up the console to fill the given area of the display with cells of
+ *  the given font. The baseline is placed so the tallest glyph touches the
+ *  top of the cell. Returns false if the font has no space character.
+ */
+
+bool TextConsole::start(const GFXfont *f, GDRect a)
+{
+    if ((f == NULL) || (' ' < f->first) || (' ' > f->last)) return false;
+    
+    font = f;
+    area = a;
+    cellWidth = f->glyph[' ' - f->first].xAdvance;
+    cellHeight = f->yAdvance;
+    if ((cellWidth == 0) || (cellHeight == 0)) return false;
+    
+    cols = a.size.width / cellWidth;
+    rows = a.size.height / cellHeight;
+    if (cols > TC_MAXCOLS) cols = TC_MAXCOLS;
+    if (rows > TC_MAXROWS) rows = TC_MAXROWS;
+    
+    int8_t top = 0;
+    for (uint16_t i = 0; i <= f->last - f->first; ++i) {
+        if (top > f->glyph[i].yOffset) top = f->glyph[i].yOffset;
+    }
+    baseline = -top;
+    
+    /*
+     *  We don't know what is on the display
+     */
+    
+    memset(shownText,0,sizeof(shownText));
+    clear();
+    return true;
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Text        															*/
+/*																			*/
+/****************************************************************************/
+
+/*  TextConsole::clear
+ *
+ *      Clear the console to spaces and home the cursor
+ */
+
+void TextConsole::clear()
+{
+    for (uint8_t r = 0; r < rows; ++r) {
+        memset(text[r],' ',cols);
+        memset(attrs[r],attr,cols);
+    }
+    col = 0;
+    row = 0;
+}
+
+/*  TextConsole::clearToEOL
+ *
+ *      Clear from the cursor to the end of the line
+ */
+
+void TextConsole::clearToEOL()
+{
+    if (col >= cols) return;
+    memset(text[row] + col,' ',cols - col);
+    memset(attrs[row] + col,attr,cols - col);
+}
+
+/*  TextConsole::gotoXY
+ *
+ *      Move the cursor
+ */
+
+void TextConsole::gotoXY(uint8_t c, uint8_t r)
+{
+    if (rows == 0) return;
+    
+    col = (c < cols) ? c : cols - 1;
+    row = (r < rows) ? r : rows - 1;
+}
+
+/*  TextConsole::scroll
+ *
+ *      Scroll the console up a line. We scroll the pixels on the display
+ *  along with our record of what was drawn, so only the new line needs to
+ *  be redrawn. If the display can't move pixels everything is redrawn.
+ */
+
+void TextConsole::scroll()
+{
+    uint8_t r;
+    
+    for (r = 1; r < rows; ++r) {
+        memcpy(text[r-1],text[r],cols);
+        memcpy(attrs[r-1],attrs[r],cols);
+    }
+    memset(text[rows-1],' ',cols);
+    memset(attrs[rows-1],attr,cols);
+    
+    GDRect clip = display.clipRect();
+    GDRect r2 = { area.origin, { (uint8_t)(cols * cellWidth), (uint8_t)(rows * cellHeight) } };
+    
+    display.clearClipRect();
+    if (display.scrollRect(r2,0,-cellHeight)) {
+        /*
+         *  The exposed bottom line still shows its old contents, which is
+         *  what our record of the bottom line already says.
+         */
+        
+        for (r = 1; r < rows; ++r) {
+            memcpy(shownText[r-1],shownText[r],cols);
+            memcpy(shownAttrs[r-1],shownAttrs[r],cols);
+        }
+    } else {
+        memset(shownText,0,sizeof(shownText));
+    }
+    display.setClipRect(clip);
+}
+
+/*  TextConsole::newLine
+ *
+ *      Move to the start of the next line, scrolling if needed
+ */
+
+void TextConsole::newLine()
+{
+    col = 0;
+    if (row < rows - 1) {
+        ++row;
+    } else {
+        scroll();
+    }
+}
+
+/*  TextConsole::putChar
+ *
+ *      Write a character at the cursor and advance. After the last column
+ *  the cursor stays past the end of the line, and we only wrap when the next
+ *  character is written, so a full line followed by a newline doesn't leave
+ *  a blank line and writing the bottom right cell doesn't scroll.
+ */
+
+void TextConsole::putChar(char ch)
+{
+    if (rows == 0) return;
+    
+    switch (ch) {
+        case '\n':
+            newLine();
+            return;
+        case '\r':
+            col = 0;
+            return;
+        case '\b':
+            if (col > 0) --col;
+            return;
+    }
+    
+    if ((ch < font->first) || (ch > font->last)) return;
+    
+    if (col >= cols) newLine();
+    text[row][col] = ch;
+    attrs[row][col] = attr;
+    ++col;
+}
+
+/*  TextConsole::print
+ *
+ *      Write a string
+ */
+
+void TextConsole::print(const char *str)
+{
+    char c;
+    
+    while (0 != (c = *str++)) putChar(c);
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Drawing     															*/
+/*																			*/
+/****************************************************************************/
+
+/*  TextConsole::drawCell
+ *
+ *      Draw a single cell. The cell is used as the clip rectangle so glyphs
+ *  can't spill into their neighbors. For page aligned cells on the SSD1306
+ *  with a page organized font this is a solid fill of the cell's column
+ *  bytes followed by a direct copy of the glyph's bytes.
+ */
+
+void TextConsole::drawCell(uint8_t c, uint8_t r, char ch, uint8_t a)
+{
+    GDRect cell = { { (uint8_t)(area.origin.x + c * cellWidth), (uint8_t)(area.origin.y + r * cellHeight) }, { cellWidth, cellHeight } };
+    bool inverse = (a & TC_INVERSE) != 0;
+    
+    display.setClipRect(cell);
+    display.setDrawingMode(inverse ? GL_WHITE : GL_BLACK);
+    display.paintRect(cell);
+    
+    if (ch != ' ') {
+        display.setDrawingMode(inverse ? GL_BLACK : GL_WHITE);
+        display.moveTo((GDPoint){ cell.origin.x, (uint8_t)(cell.origin.y + baseline) });
+        display.drawChar(ch);
+    }
+}
+
+/*  TextConsole::update
+ *
+ *      Draw every cell whose character or attribute differs from what was
+ *  last drawn. The cursor is shown by inverting its cell.
+ */
+
+uint8_t TextConsole::update()
+{
+    uint8_t count = 0;
+    
+    if (rows == 0) return 0;
+    
+    GDRect clip = display.clipRect();
+    display.setFont(font);
+    
+    for (uint8_t r = 0; r < rows; ++r) {
+        for (uint8_t c = 0; c < cols; ++c) {
+            char ch = text[r][c];
+            uint8_t a = attrs[r][c];
+            if (cursor && (r == row) && (c == col)) a ^= TC_INVERSE;
+            
+            if ((shownText[r][c] == ch) && (shownAttrs[r][c] == a)) continue;
+            
+            drawCell(c,r,ch,a);
+            shownText[r][c] = ch;
+            shownAttrs[r][c] = a;
+            ++count;
+        }
+    }
+    
+    display.setClipRect(clip);
+    display.setDrawingMode(GL_WHITE);
+    return count;
+}
+
+/*  TextConsole::flush
+ *
+ *      Draw the changed cells and write them to the display
+ */
+
+bool TextConsole::flush()
+{
+    update();
+    return display.writeDisplay();
+}
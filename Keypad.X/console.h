@@ -0,0 +1,132 @@
+/*  console.h
+ *
+ *      A fixed grid text console drawn on a GraphicDisplay. The console keeps
+ *  a buffer of the characters and attributes in each cell, along with what
+ *  was last drawn, so updating the display only redraws the cells which have
+ *  changed.
+ */
+
+#ifndef _CONSOLE_H
+#define _CONSOLE_H
+
+#include <stdint.h>
+#include "display.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Constants   															*/
+/*																			*/
+/****************************************************************************/
+
+/*
+ *  Largest console. The default fits a 6x8 font such as smallfont on a
+ *  128x64 display.
+ */
+
+#ifndef TC_MAXCOLS
+#define TC_MAXCOLS                  21
+#endif
+#ifndef TC_MAXROWS
+#define TC_MAXROWS                  8
+#endif
+
+/*
+ *  Cell attributes
+ */
+
+#define TC_NORMAL                   0
+#define TC_INVERSE                  1
+
+/****************************************************************************/
+/*																			*/
+/*	Class Declaration     													*/
+/*																			*/
+/****************************************************************************/
+
+/*  TextConsole
+ *
+ *      Text console. The font should be fixed width: the cell size is the
+ *  advance of the space character by the font's yAdvance.
+ */
+
+class TextConsole
+{
+    public:
+                            TextConsole(GraphicDisplay &display);
+                            ~TextConsole();
+                            
+        bool                start(const GFXfont *font, GDRect area);
+        
+        /*
+         *  Text
+         */
+        
+        void                putChar(char c);
+        void                print(const char *str);
+        void                clear();
+        void                clearToEOL();
+        
+        void                setAttribute(uint8_t a)
+                                {
+                                    attr = a;
+                                }
+        
+        /*
+         *  Cursor
+         */
+        
+        void                gotoXY(uint8_t col, uint8_t row);
+        uint8_t             cursorCol() const
+                                {
+                                    return col;
+                                }
+        uint8_t             cursorRow() const
+                                {
+                                    return row;
+                                }
+        void                showCursor(bool show)
+                                {
+                                    cursor = show;
+                                }
+        
+        /*
+         *  Drawing. update draws the changed cells into display memory and
+         *  returns the number drawn; flush also writes the display.
+         */
+        
+        uint8_t             update();
+        bool                flush();
+        
+    private:
+        void                newLine();
+        void                scroll();
+        void                drawCell(uint8_t c, uint8_t r, char ch, uint8_t a);
+        
+        GraphicDisplay      &display;
+        const GFXfont       *font;
+        
+        GDRect              area;
+        uint8_t             cols;
+        uint8_t             rows;
+        uint8_t             cellWidth;
+        uint8_t             cellHeight;
+        uint8_t             baseline;       /* Baseline offset within cell */
+        
+        uint8_t             col;
+        uint8_t             row;
+        uint8_t             attr;
+        bool                cursor;
+        
+        char                text[TC_MAXROWS][TC_MAXCOLS];
+        uint8_t             attrs[TC_MAXROWS][TC_MAXCOLS];
+        
+        /*
+         *  What is on the display. A character of 0 marks a cell whose
+         *  contents are unknown and must be redrawn.
+         */
+        
+        char                shownText[TC_MAXROWS][TC_MAXCOLS];
+        uint8_t             shownAttrs[TC_MAXROWS][TC_MAXCOLS];
+};
+
+#endif /* _CONSOLE_H */
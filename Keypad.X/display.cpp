@@ -29,6 +29,7 @@
 GraphicDisplay::GraphicDisplay(GDSize s) : size(s)
 {
     pos = (GDPoint){ 0, 0 };
+    clearClipRect();
     invalidate();
 }
 
@@ -71,12 +72,186 @@ void GraphicDisplay::setVBarInternal(uint8_t x, uint8_t top, uint8_t bottom)
     }
 }
 
+/*  GraphicDisplay::fillRectInternal
+ *
+ *      Internal rectangle fill. Right and bottom are inclusive.
+ */
+
+void GraphicDisplay::fillRectInternal(uint8_t left, uint8_t top, uint8_t right, uint8_t bottom)
+{
+    uint8_t x = left;
+    do {
+        setVBarInternal(x,top,bottom);
+    } while (x++ < right);
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Clipping                                                                */
+/*																			*/
+/****************************************************************************/
+
+/*  GraphicDisplay::setClipRect
+ *
+ *      Set the clip rectangle. This is limited to the display.
+ */
+
+void GraphicDisplay::setClipRect(GDRect r)
+{
+    uint16_t right = r.origin.x + r.size.width;
+    uint16_t bottom = r.origin.y + r.size.height;
+    if (right > size.width) right = size.width;
+    if (bottom > size.height) bottom = size.height;
+    
+    if ((r.origin.x >= right) || (r.origin.y >= bottom)) {
+        clipEmpty = true;
+        clipLeft = clipTop = clipRight = clipBottom = 0;
+    } else {
+        clipEmpty = false;
+        clipLeft = r.origin.x;
+        clipTop = r.origin.y;
+        clipRight = right - 1;
+        clipBottom = bottom - 1;
+    }
+}
+
+/*  GraphicDisplay::clearClipRect
+ *
+ *      Reset clipping to the full display
+ */
+
+void GraphicDisplay::clearClipRect()
+{
+    setClipRect((GDRect){ { 0, 0 }, size });
+}
+
+/*  GraphicDisplay::clipRect
+ *
+ *      Return the current clip rectangle
+ */
+
+GDRect GraphicDisplay::clipRect() const
+{
+    if (clipEmpty) return (GDRect){ { 0, 0 }, { 0, 0 } };
+    
+    return (GDRect){ { clipLeft, clipTop },
+            { (uint8_t)(clipRight - clipLeft + 1), (uint8_t)(clipBottom - clipTop + 1) } };
+}
+
+/*  GraphicDisplay::clipBegin
+ *
+ *      Test the bounding box of a primitive (inclusive) against the clip
+ *  rectangle. Returns false if nothing would be drawn. Otherwise notes if the
+ *  primitive is entirely inside the clip rectangle, so the clipping routines
+ *  below can pass straight through.
+ */
+
+bool GraphicDisplay::clipBegin(int16_t left, int16_t top, int16_t right, int16_t bottom)
+{
+    if (clipEmpty) return false;
+    if ((right < clipLeft) || (left > clipRight)) return false;
+    if ((bottom < clipTop) || (top > clipBottom)) return false;
+    
+    clipInside = (left >= clipLeft) && (right <= clipRight) &&
+                 (top >= clipTop) && (bottom <= clipBottom);
+    return true;
+}
+
+/*  GraphicDisplay::clipPixel
+ *
+ *      Draw a pixel if inside the clip rectangle
+ */
+
+void GraphicDisplay::clipPixel(int16_t x, int16_t y)
+{
+    if (!clipInside) {
+        if ((x < clipLeft) || (x > clipRight)) return;
+        if ((y < clipTop) || (y > clipBottom)) return;
+    }
+    setPixelInternal((uint8_t)x,(uint8_t)y);
+}
+
+/*  GraphicDisplay::clipHBar
+ *
+ *      Draw a horizontal bar (right inclusive), clipping the whole span
+ */
+
+void GraphicDisplay::clipHBar(int16_t left, int16_t right, int16_t y)
+{
+    if (!clipInside) {
+        if ((y < clipTop) || (y > clipBottom)) return;
+        if (left < clipLeft) left = clipLeft;
+        if (right > clipRight) right = clipRight;
+    }
+    if (left > right) return;
+    setHBarInternal((uint8_t)left,(uint8_t)right,(uint8_t)y);
+}
+
+/*  GraphicDisplay::clipVBar
+ *
+ *      Draw a vertical bar (bottom inclusive), clipping the whole span
+ */
+
+void GraphicDisplay::clipVBar(int16_t x, int16_t top, int16_t bottom)
+{
+    if (!clipInside) {
+        if ((x < clipLeft) || (x > clipRight)) return;
+        if (top < clipTop) top = clipTop;
+        if (bottom > clipBottom) bottom = clipBottom;
+    }
+    if (top > bottom) return;
+    setVBarInternal((uint8_t)x,(uint8_t)top,(uint8_t)bottom);
+}
+
 /****************************************************************************/
 /*																			*/
 /*	Dirty Rectangle Management                 								*/
 /*																			*/
 /****************************************************************************/
 
+/*  GDArea
+ *
+ *      Area of a rectangle in pixels
+ */
+
+static uint16_t GDArea(const GDRect &r)
+{
+    return (uint16_t)r.size.width * (uint16_t)r.size.height;
+}
+
+/*  GDUnion
+ *
+ *      Smallest rectangle containing both rectangles
+ */
+
+static GDRect GDUnion(const GDRect &a, const GDRect &b)
+{
+    GDRect r;
+    uint16_t right = a.origin.x + a.size.width;
+    uint16_t bottom = a.origin.y + a.size.height;
+    uint16_t bright = b.origin.x + b.size.width;
+    uint16_t bbottom = b.origin.y + b.size.height;
+
+    if (right < bright) right = bright;
+    if (bottom < bbottom) bottom = bbottom;
+    r.origin.x = (a.origin.x < b.origin.x) ? a.origin.x : b.origin.x;
+    r.origin.y = (a.origin.y < b.origin.y) ? a.origin.y : b.origin.y;
+    r.size.width = right - r.origin.x;
+    r.size.height = bottom - r.origin.y;
+    return r;
+}
+
+/*  GDMergeWaste
+ *
+ *      The number of pixels we would needlessly send if the two rectangles
+ *  were merged into one. This can be negative if the rectangles overlap.
+ */
+
+static int32_t GDMergeWaste(const GDRect &a, const GDRect &b)
+{
+    return (int32_t)GDArea(GDUnion(a,b)) - (int32_t)GDArea(a) - (int32_t)GDArea(b);
+}
+
 /*  GraphicDisplay::invalidate
  *
  *      Invalidate display
@@ -84,8 +259,31 @@ void GraphicDisplay::setVBarInternal(uint8_t x, uint8_t top, uint8_t bottom)
 
 void GraphicDisplay::invalidate()
 {
-    dirty.origin = { 0, 0 };
-    dirty.size = size;
+    dirty[0].origin = { 0, 0 };
+    dirty[0].size = size;
+    dirtyCount = 1;
+    dirtyInternal(dirty[0]);
+}
+
+/*  GraphicDisplay::invalidate
+ *
+ *      Invalidate a rectangle of the display, regardless of the clip
+ *  rectangle. Used when the device contents change behind our back.
+ */
+
+void GraphicDisplay::invalidate(GDRect r)
+{
+    uint16_t right = r.origin.x + r.size.width;
+    uint16_t bottom = r.origin.y + r.size.height;
+    
+    if ((r.origin.x >= size.width) || (r.origin.y >= size.height)) return;
+    if (right > size.width) right = size.width;
+    if (bottom > size.height) bottom = size.height;
+    if ((right <= r.origin.x) || (bottom <= r.origin.y)) return;
+    
+    r.size.width = right - r.origin.x;
+    r.size.height = bottom - r.origin.y;
+    addDirty(r);
 }
 
 /*  GraphicDisplay::validate
@@ -95,35 +293,135 @@ void GraphicDisplay::invalidate()
 
 void GraphicDisplay::validate()
 {
-    dirty = { 0, 0, 0, 0 };
+    dirtyCount = 0;
+}
+
+/*  GraphicDisplay::dirtyCost
+ *
+ *      Estimate of the number of bytes needed to send the dirty regions to
+ *  the display. By default we assume one bit per pixel; classes that derive
+ *  from this should override to reflect their own memory layout and transfer
+ *  overhead.
+ */
+
+uint16_t GraphicDisplay::dirtyCost()
+{
+    uint16_t cost = 0;
+    for (uint8_t i = 0; i < dirtyCount; ++i) {
+        cost += (GDArea(dirty[i]) + 7) / 8;
+    }
+    return cost;
 }
 
 /*	GraphicDisplay::markDirty
  *
  *		Mark region dirty. Internal routine used to update the dirty rectangle
- *  area.
+ *  set. The new area is merged with an existing region if that is cheap;
+ *  otherwise it is added as a new region. If we run out of room we merge the
+ *  pair of regions which wastes the least area.
  */
 
-void GraphicDisplay::markDirty(uint8_t left, uint8_t top, uint8_t width, uint8_t height)
+void GraphicDisplay::markDirty(int16_t left, int16_t top, int16_t width, int16_t height)
 {
-	if ((width == 0) || (height == 0)) return;
+	if ((width <= 0) || (height <= 0)) return;
+    
+    /*
+     *  Nothing outside the clip rectangle can change
+     */
+    
+    if (clipEmpty) return;
+    
+    int16_t right = left + width - 1;
+    int16_t bottom = top + height - 1;
+    if ((left > clipRight) || (top > clipBottom)) return;
+    if ((right < clipLeft) || (bottom < clipTop)) return;
+    if (left < clipLeft) left = clipLeft;
+    if (top < clipTop) top = clipTop;
+    if (right > clipRight) right = clipRight;
+    if (bottom > clipBottom) bottom = clipBottom;
+    
+    addDirty((GDRect){ { (uint8_t)left, (uint8_t)top }, { (uint8_t)(right - left + 1), (uint8_t)(bottom - top + 1) } });
+}
+
+/*	GraphicDisplay::addDirty
+ *
+ *		Add a rectangle, already clipped to the display, to the dirty set
+ */
+
+void GraphicDisplay::addDirty(const GDRect &r)
+{
+    uint8_t i,j;
 	
-	if ((dirty.size.width == 0) || (dirty.size.height == 0)) {
-		dirty.size.width = width;
-		dirty.size.height = height;
-		dirty.origin.x = left;
-		dirty.origin.y = top;
-	} else {
-		uint8_t right = left + width;
-		uint8_t bottom = top + height;
-		uint8_t dright = dirty.origin.x + dirty.size.width;
-		uint8_t dbottom = dirty.origin.y + dirty.size.height;
-		
-		if (dirty.origin.x > left) dirty.origin.x = left;
-		if (dirty.origin.y > top) dirty.origin.y = top;
-		if (dright < right) dirty.size.width = right - dirty.origin.x;
-		if (dbottom < bottom) dirty.size.height = bottom - dirty.origin.y;
-	}
+    dirtyInternal(r);
+    
+    /*
+     *  Merge into an existing region if cheap. Merging may cause the grown
+     *  region to now overlap others, so we keep merging until stable.
+     */
+    
+    for (i = 0; i < dirtyCount; ++i) {
+        if (GDMergeWaste(dirty[i],r) <= GD_DIRTYSLACK) break;
+    }
+    
+    if (i < dirtyCount) {
+        dirty[i] = GDUnion(dirty[i],r);
+        
+        j = 0;
+        while (j < dirtyCount) {
+            if ((j != i) && (GDMergeWaste(dirty[i],dirty[j]) <= GD_DIRTYSLACK)) {
+                dirty[i] = GDUnion(dirty[i],dirty[j]);
+                dirty[j] = dirty[--dirtyCount];
+                if (i == dirtyCount) i = j;
+                j = 0;
+            } else {
+                ++j;
+            }
+        }
+        return;
+    }
+    
+    /*
+     *  Add a new region if we have space
+     */
+    
+    if (dirtyCount < GD_MAXDIRTY) {
+        dirty[dirtyCount++] = r;
+        return;
+    }
+    
+    /*
+     *  We're full. Find the cheapest pair to merge, including the new
+     *  rectangle. If the new rectangle is part of the cheapest pair we
+     *  simply fold it into its partner.
+     */
+    
+    int32_t best = GDMergeWaste(dirty[0],r);
+    uint8_t bi = 0;
+    uint8_t bj = GD_MAXDIRTY;           /* GD_MAXDIRTY: new rectangle */
+    
+    for (i = 0; i < dirtyCount; ++i) {
+        int32_t w = GDMergeWaste(dirty[i],r);
+        if (w < best) {
+            best = w;
+            bi = i;
+            bj = GD_MAXDIRTY;
+        }
+        for (j = i+1; j < dirtyCount; ++j) {
+            w = GDMergeWaste(dirty[i],dirty[j]);
+            if (w < best) {
+                best = w;
+                bi = i;
+                bj = j;
+            }
+        }
+    }
+    
+    if (bj == GD_MAXDIRTY) {
+        dirty[bi] = GDUnion(dirty[bi],r);
+    } else {
+        dirty[bi] = GDUnion(dirty[bi],dirty[bj]);
+        dirty[bj] = r;
+    }
 }
 
 
@@ -176,6 +474,7 @@ uint8_t GraphicDisplay::width(const char *str)
 
 void GraphicDisplay::setPixel(uint8_t x, uint8_t y)
 {
+	if (!clipBegin(x,y,x,y)) return;
 	setPixelInternal(x,y);
 	markDirty(x,y,1,1);
 }
@@ -187,16 +486,74 @@ void GraphicDisplay::setPixel(uint8_t x, uint8_t y)
 /*																			*/
 /****************************************************************************/
 
+/*  GraphicDisplay::drawGlyphInternal
+ *
+ *      Draw the bits of a glyph of the current font with the upper left
+ *  corner at (x,y). This walks the glyph one pixel at a time; display classes
+ *  can override this with something which knows their memory layout.
+ */
+
+void GraphicDisplay::drawGlyphInternal(const GFXglyph *gdata, uint8_t xo, uint8_t yo)
+{
+	uint8_t x,y;
+	
+	/*
+	 *	Run the bits
+	 */
+	
+    uint16_t bitIndex = 0;
+	for (y = 0; y < gdata->height; ++y) {
+		for (x = 0; x < gdata->width; ++x) {
+			uint8_t b = 0x80 >> (bitIndex & 7);
+			uint16_t n = (bitIndex >> 3) + gdata->bitmapOffset;
+			if (font->bitmap[n] & b) {
+				setPixelInternal(x+xo,y+yo);
+			}
+            
+            ++bitIndex;
+		}
+	}
+}
+
+/*  GraphicDisplay::drawGlyphClipped
+ *
+ *      Draw the part of a glyph which lies inside the clip rectangle. The
+ *  visible rows and columns are worked out once for the glyph, and only those
+ *  bits are visited.
+ */
+
+void GraphicDisplay::drawGlyphClipped(const GFXglyph *gdata, int16_t xo, int16_t yo)
+{
+    int16_t x0 = clipLeft - xo;
+    int16_t y0 = clipTop - yo;
+    int16_t x1 = clipRight - xo + 1;
+    int16_t y1 = clipBottom - yo + 1;
+    
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > gdata->width) x1 = gdata->width;
+    if (y1 > gdata->height) y1 = gdata->height;
+    
+    const uint8_t *bitmap = font->bitmap + gdata->bitmapOffset;
+    for (int16_t y = y0; y < y1; ++y) {
+        uint16_t bitIndex = y * gdata->width + x0;
+        for (int16_t x = x0; x < x1; ++x, ++bitIndex) {
+            if (bitmap[bitIndex >> 3] & (0x80 >> (bitIndex & 7))) {
+                setPixelInternal(x+xo,y+yo);
+            }
+        }
+    }
+}
+
 /*  GraphicDisplay::drawChar
  *
- *      Draw a pixel.
+ *      Draw a character.
  */
 
 void GraphicDisplay::drawChar(uint16_t c)
 {
 	const GFXglyph *gdata;
-	uint16_t blen;
-	uint8_t x,y,xo,yo;
+	uint8_t xo,yo;
 	
 	/*
 	 *	Get the data for the glyph
@@ -209,36 +566,28 @@ void GraphicDisplay::drawChar(uint16_t c)
     
     gdata = font->glyph + (c - font->first);
 
-	/*
-	 *	Get the dimensions, pixel location
-	 */
-	
-	blen = ((uint16_t)gdata->width) * ((uint16_t)gdata->height);
-	uint16_t bytes = (blen + 7)/8;
-	
 	/*
 	 *	Calculate the start pixel position
 	 */
 	
-	xo = pos.x + gdata->xOffset;
-	yo = pos.y + gdata->yOffset;
-	markDirty(xo,yo,gdata->width,gdata->height);	/* Mark drawing area dirty */
+	int16_t left = pos.x + gdata->xOffset;
+	int16_t top = pos.y + gdata->yOffset;
+	xo = (uint8_t)left;
+	yo = (uint8_t)top;
 	
 	/*
-	 *	Run the bits
+	 *	Draw the bits. Glyphs entirely inside the clip rectangle take the
+	 *	fast path; glyphs straddling the edge are clipped.
 	 */
 	
-    uint16_t bitIndex = 0;
-	for (y = 0; y < gdata->height; ++y) {
-		for (x = 0; x < gdata->width; ++x) {
-			uint8_t b = 0x80 >> (bitIndex & 7);
-			uint16_t n = (bitIndex >> 3) + gdata->bitmapOffset;
-			if (font->bitmap[n] & b) {
-				setPixelInternal(x+xo,y+yo);
-			}
-            
-            ++bitIndex;
+	if ((gdata->width > 0) && (gdata->height > 0) &&
+			clipBegin(left,top,left + gdata->width - 1,top + gdata->height - 1)) {
+		if (clipInside) {
+			drawGlyphInternal(gdata,xo,yo);
+		} else {
+			drawGlyphClipped(gdata,left,top);
 		}
+		markDirty(left,top,gdata->width,gdata->height);	/* Mark drawing area dirty */
 	}
 	
 	/*
@@ -260,6 +609,159 @@ void GraphicDisplay::drawString(const char *str)
 	while (0 != (c = *str++)) drawChar(c);
 }
 
+/****************************************************************************/
+/*																			*/
+/*	Bitmap Drawing                                            				*/
+/*																			*/
+/****************************************************************************/
+
+/*  GraphicDisplay::drawBitmapInternal
+ *
+ *      Draw the src area of a bitmap with its upper left corner at (x,y). This
+ *  generic version knows nothing about pixel values, so it can only draw the
+ *  set pixels (within the mask) with setPixelInternal, whatever the raster
+ *  operation. Display classes should override this to support the raster
+ *  operations properly.
+ */
+
+void GraphicDisplay::drawBitmapInternal(uint8_t x, uint8_t y, const GDBitmap *bitmap, const GDBitmap *mask, GDRect src, uint8_t)
+{
+    for (uint8_t j = 0; j < src.size.height; ++j) {
+        uint8_t sy = src.origin.y + j;
+        for (uint8_t i = 0; i < src.size.width; ++i) {
+            uint8_t sx = src.origin.x + i;
+            if (!GDBitmapPixel(bitmap,sx,sy)) continue;
+            if (mask && !GDBitmapPixel(mask,sx,sy)) continue;
+            setPixelInternal(x+i,y+j);
+        }
+    }
+}
+
+/*  GraphicDisplay::drawBitmap
+ *
+ *      Draw a bitmap with its upper left corner at pt, combining it with the
+ *  display using the raster operation
+ */
+
+void GraphicDisplay::drawBitmap(GDPoint pt, const GDBitmap *bitmap, uint8_t rop)
+{
+    drawMaskedBitmap(pt,bitmap,NULL,rop);
+}
+
+/*  GraphicDisplay::drawMaskedBitmap
+ *
+ *      Draw a bitmap with its upper left corner at pt. Only pixels where the
+ *  mask is set are changed; the mask must be the same size as the bitmap but
+ *  may use a different format. A NULL mask changes every pixel.
+ */
+
+void GraphicDisplay::drawMaskedBitmap(GDPoint pt, const GDBitmap *bitmap, const GDBitmap *mask, uint8_t rop)
+{
+    if ((bitmap->width == 0) || (bitmap->height == 0)) return;
+    
+    /*
+     *  Clip to find the part of the bitmap which is visible
+     */
+    
+    int16_t left = pt.x;
+    int16_t top = pt.y;
+    int16_t right = left + bitmap->width - 1;
+    int16_t bottom = top + bitmap->height - 1;
+    
+    if (!clipBegin(left,top,right,bottom)) return;
+    if (left < clipLeft) left = clipLeft;
+    if (top < clipTop) top = clipTop;
+    if (right > clipRight) right = clipRight;
+    if (bottom > clipBottom) bottom = clipBottom;
+    
+    GDRect src = { { (uint8_t)(left - pt.x), (uint8_t)(top - pt.y) },
+            { (uint8_t)(right - left + 1), (uint8_t)(bottom - top + 1) } };
+    
+    drawBitmapInternal(left,top,bitmap,mask,src,rop);
+    markDirty(left,top,src.size.width,src.size.height);
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Copying Pixels                                            				*/
+/*																			*/
+/****************************************************************************/
+
+/*  GraphicDisplay::copyBitsInternal
+ *
+ *      Copy the src rectangle to dst. Both are entirely on the display, but
+ *  may overlap. The core class cannot read pixels, so this returns false;
+ *  display classes override this.
+ */
+
+bool GraphicDisplay::copyBitsInternal(GDRect, GDPoint)
+{
+    return false;
+}
+
+/*  GraphicDisplay::copyBits
+ *
+ *      Copy the pixels in the src rectangle so its upper left corner is at
+ *  dst. The destination is clipped to the clip rectangle, and only source
+ *  pixels on the display are copied.
+ */
+
+bool GraphicDisplay::copyBits(GDRect src, GDPoint dst)
+{
+    if ((src.size.width == 0) || (src.size.height == 0)) return true;
+    if (clipEmpty) return true;
+    
+    /*
+     *  Clip the destination to the clip rectangle and the source to the
+     *  display, keeping the two lined up.
+     */
+    
+    int16_t sx = src.origin.x;
+    int16_t sy = src.origin.y;
+    int16_t dx = dst.x;
+    int16_t dy = dst.y;
+    int16_t w = src.size.width;
+    int16_t h = src.size.height;
+    int16_t d;
+    
+    if ((d = clipLeft - dx) > 0) { dx += d; sx += d; w -= d; }
+    if ((d = clipTop - dy) > 0) { dy += d; sy += d; h -= d; }
+    if ((d = dx + w - 1 - clipRight) > 0) w -= d;
+    if ((d = dy + h - 1 - clipBottom) > 0) h -= d;
+    if ((d = sx + w - size.width) > 0) w -= d;
+    if ((d = sy + h - size.height) > 0) h -= d;
+    if ((w <= 0) || (h <= 0)) return true;
+    
+    GDRect r = { { (uint8_t)sx, (uint8_t)sy }, { (uint8_t)w, (uint8_t)h } };
+    if (!copyBitsInternal(r,(GDPoint){ (uint8_t)dx, (uint8_t)dy })) return false;
+    
+    markDirty(dx,dy,w,h);
+    return true;
+}
+
+/*  GraphicDisplay::scrollRect
+ *
+ *      Scroll the contents of the rectangle by (dx,dy). Pixels scrolled out of
+ *  the rectangle are lost; the strip exposed on the opposite side keeps its
+ *  old contents and should be redrawn by the caller.
+ */
+
+bool GraphicDisplay::scrollRect(GDRect r, int8_t dx, int8_t dy)
+{
+    int16_t w = r.size.width - (dx < 0 ? -dx : dx);
+    int16_t h = r.size.height - (dy < 0 ? -dy : dy);
+    if ((w <= 0) || (h <= 0)) return true;      /* Everything scrolled out */
+    
+    GDRect src = r;
+    GDPoint dst = r.origin;
+    if (dx > 0) dst.x += dx; else src.origin.x -= dx;
+    if (dy > 0) dst.y += dy; else src.origin.y -= dy;
+    src.size.width = w;
+    src.size.height = h;
+    
+    return copyBits(src,dst);
+}
+
 /****************************************************************************/
 /*																			*/
 /*	Graphic Drawing                                            				*/
@@ -290,8 +792,10 @@ void GraphicDisplay::lineTo(GDPoint pt)
 			miny = pt.y;
 			maxy = pos.y;
 		}
-		setVBarInternal(pt.x,miny,maxy);
-		markDirty(pt.x,miny,1,maxy-miny+1);
+		if (clipBegin(pt.x,miny,pt.x,maxy)) {
+			clipVBar(pt.x,miny,maxy);
+			markDirty(pt.x,miny,1,maxy-miny+1);
+		}
         pos = pt;
 		return;
 	} 
@@ -303,8 +807,10 @@ void GraphicDisplay::lineTo(GDPoint pt)
 			minx = pt.x;
 			maxx = pos.x;
 		}
-		setHBarInternal(minx,maxx,pt.y);
-		markDirty(minx,pt.y,maxx-minx+1,1);
+		if (clipBegin(minx,pt.y,maxx,pt.y)) {
+			clipHBar(minx,maxx,pt.y);
+			markDirty(minx,pt.y,maxx-minx+1,1);
+		}
         pos = pt;
 		return;
 	}
@@ -327,6 +833,10 @@ void GraphicDisplay::lineTo(GDPoint pt)
 		miny = pt.y;
 		maxy = pos.y;
 	}
+	if (!clipBegin(minx,miny,maxx,maxy)) {
+		pos = pt;
+		return;
+	}
 	markDirty(minx,miny,maxx-minx+1,maxy-miny+1);
 
 	/*
@@ -353,7 +863,7 @@ void GraphicDisplay::lineTo(GDPoint pt)
 	
     GDPoint p = pos;
 	for (;;) {
-		setPixelInternal(p.x,p.y);
+		clipPixel(p.x,p.y);
 		
 		err2 = err << 1;
 		if (err2 >= -(int16_t)dy) {
@@ -378,13 +888,25 @@ void GraphicDisplay::lineTo(GDPoint pt)
 
 void GraphicDisplay::paintRect(GDRect r)
 {
-	uint8_t right = r.origin.x + r.size.width;
-	uint8_t bottom = r.origin.y + r.size.height - 1;	/* Because setVBarInternal includes bottom */
-	for (uint8_t x = r.origin.x; x < right; ++x) {
-		setVBarInternal(x,r.origin.y,bottom);
-	}
+	if ((r.size.width == 0) || (r.size.height == 0)) return;
 	
-	markDirty(r.origin.x,r.origin.y,r.size.width,r.size.height);
+	/*
+	 *	Clip the rectangle as a whole
+	 */
+	
+	int16_t left = r.origin.x;
+	int16_t top = r.origin.y;
+	int16_t right = left + r.size.width - 1;
+	int16_t bottom = top + r.size.height - 1;	/* Because setVBarInternal includes bottom */
+	
+	if (!clipBegin(left,top,right,bottom)) return;
+	if (left < clipLeft) left = clipLeft;
+	if (top < clipTop) top = clipTop;
+	if (right > clipRight) right = clipRight;
+	if (bottom > clipBottom) bottom = clipBottom;
+	
+	fillRectInternal(left,top,right,bottom);
+	markDirty(left,top,right-left+1,bottom-top+1);
 }
 
 /*	GraphicDisplay::frameRect
@@ -396,26 +918,27 @@ void GraphicDisplay::paintRect(GDRect r)
 void GraphicDisplay::frameRect(GDRect r)
 {
 	if ((r.size.width == 0) || (r.size.height == 0)) return;
+	if (!clipBegin(r.origin.x,r.origin.y,r.origin.x + r.size.width - 1,r.origin.y + r.size.height - 1)) return;
 	markDirty(r.origin.x,r.origin.y,r.size.width,r.size.height);
 	
 	if (r.size.width == 1) {
-		setVBarInternal(r.origin.x,r.origin.y,r.origin.y + r.size.height - 1);		
+		clipVBar(r.origin.x,r.origin.y,r.origin.y + r.size.height - 1);		
 	} else if (r.size.height == 1) {
-		setHBarInternal(r.origin.x,r.origin.x + r.size.width - 1,r.origin.y);
+		clipHBar(r.origin.x,r.origin.x + r.size.width - 1,r.origin.y);
 	} else {
 		
 		/*
 		 *	Draw two vertical bars then fill horizontal
 		 */
 		
-		uint8_t bottom = r.origin.y + r.size.height - 1;
-		uint8_t right = r.origin.x + r.size.width;
-		setVBarInternal(r.origin.x,r.origin.y,bottom);
-		setVBarInternal(right - 1,r.origin.y,bottom);
+		int16_t bottom = r.origin.y + r.size.height - 1;
+		int16_t right = r.origin.x + r.size.width;
+		clipVBar(r.origin.x,r.origin.y,bottom);
+		clipVBar(right - 1,r.origin.y,bottom);
 		
 		if (r.size.width > 2) {
-			setHBarInternal(r.origin.x+1,right-2,r.origin.y);
-			setHBarInternal(r.origin.x+1,right-2,bottom);
+			clipHBar(r.origin.x+1,right-2,r.origin.y);
+			clipHBar(r.origin.x+1,right-2,bottom);
 		}
 	}
 }
@@ -428,15 +951,16 @@ void GraphicDisplay::frameRect(GDRect r)
 void GraphicDisplay::frameOval(GDRect r)
 {
     if ((r.size.width == 0) || (r.size.height == 0)) return;
+    if (!clipBegin(r.origin.x,r.origin.y,r.origin.x + r.size.width,r.origin.y + r.size.height)) return;
 
-    /* Mark dirty */
-    markDirty(r.origin.x,r.origin.y,r.size.width,r.size.height);
+    /* Mark dirty. The oval runs to x + width, y + height inclusive */
+    markDirty(r.origin.x,r.origin.y,r.size.width + 1,r.size.height + 1);
     
     /* Preflight */
-    uint8_t x0 = r.origin.x;
-    uint8_t y0 = r.origin.y;
-    uint8_t x1 = x0 + r.size.width;
-    uint8_t y1 = y0 + r.size.height;
+    int16_t x0 = r.origin.x;
+    int16_t y0 = r.origin.y;
+    int16_t x1 = x0 + r.size.width;
+    int16_t y1 = y0 + r.size.height;
     
     int32_t a = r.size.width;
     int32_t b = r.size.height;
@@ -453,10 +977,10 @@ void GraphicDisplay::frameOval(GDRect r)
     b1 = 8 * b * b;
     
     do {
-        setPixelInternal(x1,y0);
-        setPixelInternal(x0,y0);
-        setPixelInternal(x0,y1);
-        setPixelInternal(x1,y1);
+        clipPixel(x1,y0);
+        clipPixel(x0,y0);
+        clipPixel(x0,y1);
+        clipPixel(x1,y1);
         
         e2 = 2 * err;
         if (e2 <= dy) {
@@ -474,11 +998,11 @@ void GraphicDisplay::frameOval(GDRect r)
     } while (x0 <= x1);
     
     while (y0 - y1 <= b) {
-        setPixelInternal(x0-1,y0);
-        setPixelInternal(x1+1,y0);
+        clipPixel(x0-1,y0);
+        clipPixel(x1+1,y0);
         ++y0;
-        setPixelInternal(x0-1,y1);
-        setPixelInternal(x1+1,y1);
+        clipPixel(x0-1,y1);
+        clipPixel(x1+1,y1);
         --y1;
     }
 }
@@ -492,15 +1016,16 @@ void GraphicDisplay::frameOval(GDRect r)
 void GraphicDisplay::paintOval(GDRect r)
 {
     if ((r.size.width == 0) || (r.size.height == 0)) return;
+    if (!clipBegin(r.origin.x,r.origin.y,r.origin.x + r.size.width,r.origin.y + r.size.height)) return;
 
-    /* Mark dirty */
-    markDirty(r.origin.x,r.origin.y,r.size.width,r.size.height);
+    /* Mark dirty. The oval runs to x + width, y + height inclusive */
+    markDirty(r.origin.x,r.origin.y,r.size.width + 1,r.size.height + 1);
     
     /* Preflight */
-    uint8_t x0 = r.origin.x;
-    uint8_t y0 = r.origin.y;
-    uint8_t x1 = x0 + r.size.width;
-    uint8_t y1 = y0 + r.size.height;
+    int16_t x0 = r.origin.x;
+    int16_t y0 = r.origin.y;
+    int16_t x1 = x0 + r.size.width;
+    int16_t y1 = y0 + r.size.height;
     
     int32_t a = r.size.width;
     int32_t b = r.size.height;
@@ -517,8 +1042,8 @@ void GraphicDisplay::paintOval(GDRect r)
     b1 = 8 * b * b;
     
     do {
-        setVBarInternal(x0,y1,y0);
-        setVBarInternal(x1,y1,y0);
+        clipVBar(x0,y1,y0);
+        clipVBar(x1,y1,y0);
         
         e2 = 2 * err;
         if (e2 <= dy) {
@@ -536,8 +1061,8 @@ void GraphicDisplay::paintOval(GDRect r)
     } while (x0 <= x1);
     
     while (y0 - y1 <= b) {
-        setVBarInternal(x0-1,y1,y0);
-        setVBarInternal(x1+1,y1,y0);
+        clipVBar(x0-1,y1,y0);
+        clipVBar(x1+1,y1,y0);
         ++y0;
         --y1;
     }
@@ -548,7 +1073,7 @@ void GraphicDisplay::paintOval(GDRect r)
  *      Draw or fill rounded corner, used for rounded rectangles
  */
 
-void GraphicDisplay::drawCorner(uint8_t xm, uint8_t ym, uint8_t r, uint8_t cmask)
+void GraphicDisplay::drawCorner(int16_t xm, int16_t ym, uint8_t r, uint8_t cmask)
 {
     int8_t x = -r;
     int8_t y = 0;
@@ -557,15 +1082,15 @@ void GraphicDisplay::drawCorner(uint8_t xm, uint8_t ym, uint8_t r, uint8_t cmask
     
     do {
         if (cmask & 0x10) {
-            if (cmask & 1) setVBarInternal(xm-x,ym,ym+y);
-            if (cmask & 2) setVBarInternal(xm-y,ym,ym-x);
-            if (cmask & 4) setVBarInternal(xm+x,ym-y,ym);
-            if (cmask & 8) setVBarInternal(xm+y,ym+x,ym);
+            if (cmask & 1) clipVBar(xm-x,ym,ym+y);
+            if (cmask & 2) clipVBar(xm-y,ym,ym-x);
+            if (cmask & 4) clipVBar(xm+x,ym-y,ym);
+            if (cmask & 8) clipVBar(xm+y,ym+x,ym);
         } else {
-            if (cmask & 1) setPixelInternal(xm-x,ym+y);
-            if (cmask & 2) setPixelInternal(xm-y,ym-x);
-            if (cmask & 4) setPixelInternal(xm+x,ym-y);
-            if (cmask & 8) setPixelInternal(xm+y,ym+x);
+            if (cmask & 1) clipPixel(xm-x,ym+y);
+            if (cmask & 2) clipPixel(xm-y,ym-x);
+            if (cmask & 4) clipPixel(xm+x,ym-y);
+            if (cmask & 8) clipPixel(xm+y,ym+x);
         }
         
         int8_t tmp = err;
@@ -593,18 +1118,22 @@ void GraphicDisplay::frameRoundRect(GDRect r, uint8_t corner)
     
     if (corner > maxr) corner = maxr;
     
+    if ((r.size.width == 0) || (r.size.height == 0)) return;
+    if (!clipBegin(r.origin.x,r.origin.y,r.origin.x + r.size.width - 1,r.origin.y + r.size.height - 1)) return;
+    markDirty(r.origin.x,r.origin.y,r.size.width,r.size.height);
+    
     /*
      *  Draw the rounded rectangle
      */
     
     drawCorner(r.origin.x + corner, r.origin.y + corner, corner, 0x04);
-    setHBarInternal(r.origin.x + corner + 1, r.origin.x + r.size.width - corner - 2, r.origin.y);
+    clipHBar(r.origin.x + corner + 1, r.origin.x + r.size.width - corner - 2, r.origin.y);
     drawCorner(r.origin.x + r.size.width - corner - 1, r.origin.y + corner, corner, 0x08);
-    setVBarInternal(r.origin.x + r.size.width - 1, r.origin.y + corner + 1, r.origin.y + r.size.height - corner - 2);
+    clipVBar(r.origin.x + r.size.width - 1, r.origin.y + corner + 1, r.origin.y + r.size.height - corner - 2);
     drawCorner(r.origin.x + r.size.width - corner - 1, r.origin.y + r.size.height - corner - 1, corner, 0x01);
-    setHBarInternal(r.origin.x + corner + 1, r.origin.x + r.size.width - corner - 2, r.origin.y + r.size.height - 1);
+    clipHBar(r.origin.x + corner + 1, r.origin.x + r.size.width - corner - 2, r.origin.y + r.size.height - 1);
     drawCorner(r.origin.x + corner, r.origin.y + r.size.height - corner - 1, corner, 0x02);
-    setVBarInternal(r.origin.x, r.origin.y + corner + 1, r.origin.y + r.size.height - corner - 2);
+    clipVBar(r.origin.x, r.origin.y + corner + 1, r.origin.y + r.size.height - corner - 2);
 }
 
 /*  GraphicDisplay::paintRoundRect
@@ -620,8 +1149,14 @@ void GraphicDisplay::paintRoundRect(GDRect r, uint8_t corner)
     
     if (corner > maxr) corner = maxr;
     
+    if ((r.size.width == 0) || (r.size.height == 0)) return;
+    if (!clipBegin(r.origin.x,r.origin.y,r.origin.x + r.size.width - 1,r.origin.y + r.size.height - 1)) return;
+    
+    markDirty(r.origin.x,r.origin.y,r.size.width,r.size.height);
+    
     /*
-     *  Draw the rounded rectangle
+     *  Draw the rounded rectangle. The corners are drawn first, as paintRect
+     *  does its own clipping.
      */
     
     drawCorner(r.origin.x + corner, r.origin.y + corner, corner, 0x14);
@@ -46,6 +46,85 @@ struct GDRect {
 	GDSize size;
 };
 
+/****************************************************************************/
+/*																			*/
+/*	Constants																*/
+/*																			*/
+/****************************************************************************/
+
+/*
+ *  Dirty region tracking. We track up to GD_MAXDIRTY separate rectangles;
+ *  two regions are merged when the area wasted by their union is no larger
+ *  than GD_DIRTYSLACK pixels, since sending a few extra bytes is cheaper
+ *  than the overhead of setting up another transfer.
+ */
+
+#define GD_MAXDIRTY                 4
+#define GD_DIRTYSLACK               128
+
+/*
+ *  Drawing modes
+ */
+
+#define GL_BLACK       				0
+#define GL_WHITE       				1
+#define GL_XOR         				2
+
+/*
+ *  Bitmap formats
+ */
+
+#define GD_BITMAP_MSB               0       /* Row-major, MSB leftmost (Adafruit) */
+#define GD_BITMAP_LSB               1       /* Row-major, LSB leftmost (XBM) */
+#define GD_BITMAP_PAGE              2       /* Page organized columns */
+
+/*
+ *  Bitmap raster operations. A set bit in a bitmap is a lit pixel.
+ */
+
+#define GD_ROP_COPY                 0       /* dest = src */
+#define GD_ROP_OR                   1       /* dest |= src */
+#define GD_ROP_AND                  2       /* dest &= src */
+#define GD_ROP_XOR                  3       /* dest ^= src */
+
+/****************************************************************************/
+/*																			*/
+/*	Bitmap Structures     													*/
+/*																			*/
+/****************************************************************************/
+
+/*  GDBitmap
+ *
+ *      A one bit per pixel bitmap. Row-major bitmaps pad each row to a whole
+ *  byte. Page organized bitmaps are stored as (height + 7) / 8 rows of width
+ *  bytes, each byte a vertical run of 8 pixels with the LSB at the top; this
+ *  is the same layout as SSD1306 display memory.
+ */
+
+struct GDBitmap {
+    const uint8_t *data;
+    uint8_t width,height;
+    uint8_t format;         /* GD_BITMAP_xxx */
+};
+
+/*  GDBitmapPixel
+ *
+ *      Returns the pixel at (x,y) in the bitmap
+ */
+
+static inline bool GDBitmapPixel(const GDBitmap *b, uint8_t x, uint8_t y)
+{
+    switch (b->format) {
+        default:
+        case GD_BITMAP_MSB:
+            return 0 != (b->data[y * ((b->width + 7) >> 3) + (x >> 3)] & (0x80 >> (x & 7)));
+        case GD_BITMAP_LSB:
+            return 0 != (b->data[y * ((b->width + 7) >> 3) + (x >> 3)] & (0x01 << (x & 7)));
+        case GD_BITMAP_PAGE:
+            return 0 != (b->data[(y >> 3) * b->width + x] & (0x01 << (y & 7)));
+    }
+}
+
 /****************************************************************************/
 /*																			*/
 /*	Font Structures     													*/
@@ -79,6 +158,12 @@ typedef struct GFXglyph {
  *
  *      The font data stored for the font as a whole. This is an array of
  *  glyphs which refer to offsets inside the bitmap data
+ * 
+ *      Optionally a font may also carry its glyphs in page organized form:
+ *  each glyph stored as (height + 7) / 8 rows of width bytes, each byte a
+ *  vertical run of 8 pixels with the LSB at the top. This matches the memory
+ *  layout of displays such as the SSD1306. This data is generated from the
+ *  Adafruit bitmaps by host/pagefont, and is NULL for fonts without it.
  */
 
 typedef struct GFXfont {
@@ -87,6 +172,8 @@ typedef struct GFXfont {
 	uint16_t first;   ///< ASCII extents (first char)
 	uint16_t last;    ///< ASCII extents (last char)
 	uint8_t yAdvance; ///< Newline distance (y axis)
+	const uint8_t *pageBitmap;  ///< Page organized glyphs, or NULL
+	const uint16_t *pageOffset; ///< Offset of each glyph in pageBitmap
 } GFXfont;
 
 /****************************************************************************/
@@ -119,15 +206,44 @@ class GraphicDisplay
         virtual bool        writeDisplay() = 0;
         
         /*
-         *  Dirty rectangle management. Internally we track the largest rectangle
-         *  of data that may have been invalidated during drawing. This can then
-         *  be used by a class that derives from this class to minimize I/O
-         *  operations to write the area of the display that has changed.
+         *  Drawing mode (GL_xxx). Displays without drawing modes ignore this.
+         */
+        
+        virtual void        setDrawingMode(uint8_t)
+                                {
+                                }
+        
+        /*
+         *  Dirty rectangle management. Internally we track a small set of
+         *  rectangles of data that may have been invalidated during drawing.
+         *  This can then be used by a class that derives from this class to
+         *  minimize I/O operations to write the areas of the display that have
+         *  changed.
          */
        
         void                invalidate();
+        void                invalidate(GDRect r);
         void                validate();
         
+        uint8_t             dirtyRegionCount() const
+                                {
+                                    return dirtyCount;
+                                }
+        GDRect              dirtyRegion(uint8_t i) const
+                                {
+                                    return dirty[i];
+                                }
+        virtual uint16_t    dirtyCost();
+        
+        /*
+         *  Clipping. All drawing is limited to the clip rectangle, which
+         *  defaults to the full display.
+         */
+        
+        void                setClipRect(GDRect r);
+        void                clearClipRect();
+        GDRect              clipRect() const;
+        
         /*
          *  Font management
          */
@@ -136,6 +252,10 @@ class GraphicDisplay
                                 {
                                     font = f;
                                 }
+        const GFXfont      *currentFont() const
+                                {
+                                    return font;
+                                }
 
 		uint8_t             width(uint16_t c);
 		uint8_t             width(const char *text);
@@ -157,6 +277,17 @@ class GraphicDisplay
 		void                lineTo(GDPoint pt);
 		
 		void                drawString(const char *text);
+        
+        void                drawBitmap(GDPoint pt, const GDBitmap *bitmap, uint8_t rop = GD_ROP_COPY);
+        void                drawMaskedBitmap(GDPoint pt, const GDBitmap *bitmap, const GDBitmap *mask, uint8_t rop = GD_ROP_COPY);
+        
+        /*
+         *  Moving pixels. These return false if the display class cannot
+         *  copy pixels, in which case the caller must redraw the area.
+         */
+        
+        bool                copyBits(GDRect src, GDPoint dst);
+        bool                scrollRect(GDRect r, int8_t dx, int8_t dy);
 		void                drawChar(uint16_t c);
 		
 		void                paintRect(GDRect r);
@@ -174,17 +305,54 @@ class GraphicDisplay
         virtual void        setPixelInternal(uint8_t x, uint8_t y) = 0;
         virtual void        setHBarInternal(uint8_t left, uint8_t right, uint8_t y);
         virtual void        setVBarInternal(uint8_t x, uint8_t top, uint8_t bottom);
+        virtual void        fillRectInternal(uint8_t left, uint8_t top, uint8_t right, uint8_t bottom);
+        virtual void        drawGlyphInternal(const GFXglyph *g, uint8_t x, uint8_t y);
+        virtual void        drawBitmapInternal(uint8_t x, uint8_t y, const GDBitmap *bitmap, const GDBitmap *mask, GDRect src, uint8_t rop);
+        virtual bool        copyBitsInternal(GDRect src, GDPoint dst);
+        
+        /*
+         *  Called with each rectangle as it is marked dirty, before it is
+         *  merged into the dirty set
+         */
+        
+        virtual void        dirtyInternal(const GDRect &)
+                                {
+                                }
+        
+        /*
+         *  Clipping support. A primitive calls clipBegin with its bounding box
+         *  (inclusive); this trivially rejects primitives outside the clip
+         *  rectangle and notes if the primitive is entirely inside, in which
+         *  case the clip routines below skip their tests. Coordinates are
+         *  signed and unclipped, so primitives may run off any edge.
+         */
+        
+        bool                clipBegin(int16_t left, int16_t top, int16_t right, int16_t bottom);
+        void                clipPixel(int16_t x, int16_t y);
+        void                clipHBar(int16_t left, int16_t right, int16_t y);
+        void                clipVBar(int16_t x, int16_t top, int16_t bottom);
 
     private:
-        void                markDirty(uint8_t left, uint8_t top, uint8_t width, uint8_t height);
-        void                drawCorner(uint8_t x, uint8_t y, uint8_t r, uint8_t cmask);
+        void                markDirty(int16_t left, int16_t top, int16_t width, int16_t height);
+        void                addDirty(const GDRect &r);
+        void                drawCorner(int16_t x, int16_t y, uint8_t r, uint8_t cmask);
+        void                drawGlyphClipped(const GFXglyph *g, int16_t x, int16_t y);
     
     protected:
         const GFXfont       *font;
         
         GDPoint             pos;
         GDSize              size;
-        GDRect              dirty;
+        
+        uint8_t             dirtyCount;
+        GDRect              dirty[GD_MAXDIRTY];
+        
+        bool                clipEmpty;          /* Nothing can be drawn */
+        bool                clipInside;         /* Primitive is inside clip */
+        uint8_t             clipLeft;           /* Clip bounds, inclusive */
+        uint8_t             clipTop;
+        uint8_t             clipRight;
+        uint8_t             clipBottom;
 };
 
 
@@ -0,0 +1,172 @@
+/*  bitmaptest.cpp
+ *
+ *      Host test for SSD1306 bitmap drawing. Random bitmaps in each format,
+ *  with and without a mask, are drawn with each raster operation at random
+ *  positions and clip rectangles over random display contents, and the
+ *  result is checked against a per-pixel model. From this directory:
+ *
+ *      g++ -I. -I.. -o bitmaptest bitmaptest.cpp twirecord.c \
+ *          ../ssd1306.cpp ../display.cpp
+ *      ./bitmaptest
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssd1306.h"
+#include "timers.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Constants																*/
+/*																			*/
+/****************************************************************************/
+
+#define WIDTH           128
+#define HEIGHT          64
+#define RANDOMTESTS     20000
+
+/****************************************************************************/
+/*																			*/
+/*	Timer Stand-ins															*/
+/*																			*/
+/****************************************************************************/
+
+uint32_t GetMilliseconds(void)
+{
+    return 0;
+}
+
+void DelayMilliseconds(uint16_t)
+{
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Test Support															*/
+/*																			*/
+/****************************************************************************/
+
+class Test: public SSD1306
+{
+    public:
+        uint8_t    *memory()
+                        {
+                            return display;
+                        }
+};
+
+static Test Display;
+static uint8_t Model[SSD1306_MEMORY];
+
+static uint8_t BitmapData[4096];
+static uint8_t MaskData[4096];
+
+static bool ModelPixel(int x, int y)
+{
+    return (Model[x + (y >> 3) * WIDTH] >> (y & 7)) & 1;
+}
+
+static void SetModelPixel(int x, int y, bool on)
+{
+    uint8_t bit = 1 << (y & 7);
+    if (on) Model[x + (y >> 3) * WIDTH] |= bit;
+    else Model[x + (y >> 3) * WIDTH] &= ~bit;
+}
+
+/*  RandomBitmap
+ *
+ *      Fill in a random bitmap of the given size
+ */
+
+static void RandomBitmap(GDBitmap &b, uint8_t *data, uint8_t width, uint8_t height)
+{
+    for (uint16_t i = 0; i < sizeof(BitmapData); ++i) data[i] = rand();
+    b.data = data;
+    b.width = width;
+    b.height = height;
+    b.format = rand() % 3;
+}
+
+/*  Draw
+ *
+ *      What the model expects of drawMaskedBitmap
+ */
+
+static void Draw(GDPoint pt, const GDBitmap *bitmap, const GDBitmap *mask, uint8_t rop, GDRect clip)
+{
+    for (int j = 0; j < bitmap->height; ++j) {
+        for (int i = 0; i < bitmap->width; ++i) {
+            int x = pt.x + i;
+            int y = pt.y + j;
+
+            if ((x < clip.origin.x) || (x >= clip.origin.x + clip.size.width)) continue;
+            if ((y < clip.origin.y) || (y >= clip.origin.y + clip.size.height)) continue;
+            if (mask && !GDBitmapPixel(mask,i,j)) continue;
+
+            bool s = GDBitmapPixel(bitmap,i,j);
+            bool d = ModelPixel(x,y);
+            switch (rop) {
+                case GD_ROP_COPY:   d = s;      break;
+                case GD_ROP_OR:     d |= s;     break;
+                case GD_ROP_AND:    d &= s;     break;
+                case GD_ROP_XOR:    d ^= s;     break;
+            }
+            SetModelPixel(x,y,d);
+        }
+    }
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Tests																	*/
+/*																			*/
+/****************************************************************************/
+
+int main()
+{
+    static const char *formatName[] = { "msb", "lsb", "page" };
+    uint32_t failures = 0;
+
+    srand(1);
+    for (uint32_t n = 0; n < RANDOMTESTS; ++n) {
+        GDBitmap bitmap,mask;
+        bool masked = (rand() % 2) != 0;
+        uint8_t rop = rand() % 4;
+        GDPoint pt;
+        GDRect clip = { { 0, 0 }, { WIDTH, HEIGHT } };
+
+        RandomBitmap(bitmap,BitmapData,1 + rand() % 100,1 + rand() % 80);
+        RandomBitmap(mask,MaskData,bitmap.width,bitmap.height);
+
+        pt.x = rand() % (WIDTH + 16);
+        pt.y = rand() % (HEIGHT + 16);
+        if (rand() % 3 == 0) {
+            clip.origin.x = rand() % WIDTH;
+            clip.origin.y = rand() % HEIGHT;
+            clip.size.width = 1 + rand() % (WIDTH - clip.origin.x);
+            clip.size.height = 1 + rand() % (HEIGHT - clip.origin.y);
+        }
+
+        for (uint16_t i = 0; i < SSD1306_MEMORY; ++i) Model[i] = rand();
+        memcpy(Display.memory(),Model,SSD1306_MEMORY);
+
+        Display.setClipRect(clip);
+        Display.drawMaskedBitmap(pt,&bitmap,masked ? &mask : NULL,rop);
+        Display.clearClipRect();
+        Draw(pt,&bitmap,masked ? &mask : NULL,rop,clip);
+
+        if (memcmp(Display.memory(),Model,SSD1306_MEMORY)) {
+            if (++failures <= 10) {
+                printf("FAIL %s %dx%d at %d,%d rop %d mask %s clip {%d,%d,%d,%d}\n",
+                        formatName[bitmap.format],bitmap.width,bitmap.height,
+                        pt.x,pt.y,rop,masked ? formatName[mask.format] : "none",
+                        clip.origin.x,clip.origin.y,clip.size.width,clip.size.height);
+            }
+        }
+    }
+
+    printf("%s: %u failures\n",failures ? "FAIL" : "PASS",failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,320 @@
+/*  cliptest.cpp
+ *
+ *      Host test for drawing rectangles and ovals which run off the edge of
+ *  the display or the clip rectangle, including past coordinate 255. Each
+ *  shape is drawn into a cleared display and checked pixel by pixel against
+ *  a simple model, and the display is then flushed through the emulator to
+ *  check nothing was drawn outside the dirty regions. From this directory:
+ *
+ *      g++ -I. -I.. -o cliptest cliptest.cpp ssd1306emu.c twirecord.c \
+ *          ../ssd1306.cpp ../display.cpp
+ *      ./cliptest
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssd1306.h"
+#include "ssd1306emu.h"
+#include "timers.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Constants																*/
+/*																			*/
+/****************************************************************************/
+
+#define WIDTH           128
+#define HEIGHT          64
+#define RANDOMTESTS     5000
+
+#define SHAPE_PAINT     0
+#define SHAPE_FRAME     1
+#define SHAPE_ROUND     2               /* Framed, rounded */
+#define SHAPE_OVAL      3               /* Framed */
+#define SHAPE_FILLOVAL  4
+#define SHAPES          5
+
+/****************************************************************************/
+/*																			*/
+/*	Timer Stand-ins															*/
+/*																			*/
+/****************************************************************************/
+
+uint32_t GetMilliseconds(void)
+{
+    return 0;
+}
+
+void DelayMilliseconds(uint16_t)
+{
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Test Support															*/
+/*																			*/
+/****************************************************************************/
+
+class Test: public SSD1306
+{
+    public:
+        bool        pixel(uint8_t x, uint8_t y)
+                        {
+                            return (display[x + (y >> 3) * WIDTH] >> (y & 7)) & 1;
+                        }
+        const uint8_t *memory()
+                        {
+                            return display;
+                        }
+};
+
+static Test Display;
+static SSD1306Emu Emu;
+static uint32_t Failures;
+
+static const char *ShapeName[] = { "paintRect", "frameRect", "frameRoundRect", "frameOval", "paintOval" };
+
+/*
+ *  The pixels of the oval being checked, drawn by OvalModel
+ */
+
+static bool Oval[HEIGHT][WIDTH];
+
+/*  Inside
+ *
+ *      True if (x,y) is inside the rectangle, computed without wrapping
+ */
+
+static bool Inside(int x, int y, GDRect r)
+{
+    return (x >= r.origin.x) && (x < r.origin.x + r.size.width) &&
+           (y >= r.origin.y) && (y < r.origin.y + r.size.height);
+}
+
+/*  OvalPixel, OvalBar
+ *
+ *      Plot into the oval model, clipped to the display and clip rectangle
+ */
+
+static void OvalPixel(int x, int y, GDRect clip)
+{
+    if ((x >= 0) && (x < WIDTH) && (y >= 0) && (y < HEIGHT) && Inside(x,y,clip)) Oval[y][x] = true;
+}
+
+static void OvalBar(int x, int top, int bottom, GDRect clip)
+{
+    for (int y = top; y <= bottom; ++y) OvalPixel(x,y,clip);
+}
+
+/*  OvalModel
+ *
+ *      The oval as frameOval and paintOval draw it (the same midpoint
+ *  algorithm) but in int arithmetic, so nothing wraps
+ */
+
+static void OvalModel(GDRect r, bool fill, GDRect clip)
+{
+    memset(Oval,0,sizeof(Oval));
+
+    int x0 = r.origin.x;
+    int y0 = r.origin.y;
+    int x1 = x0 + r.size.width;
+    int y1;
+
+    int32_t a = r.size.width;
+    int32_t b = r.size.height;
+    int32_t b1 = b & 1;
+
+    int32_t dx = 4 * (1 - a) * b * b;
+    int32_t dy = 4 * (b1 + 1) * a * a;
+    int32_t err = dx + dy + b1 * a * a;
+    int32_t e2;
+
+    y0 += (b + 1)/2;
+    y1 = y0 - b1;
+    a *= 8 * a;
+    b1 = 8 * b * b;
+
+    do {
+        if (fill) {
+            OvalBar(x0,y1,y0,clip);
+            OvalBar(x1,y1,y0,clip);
+        } else {
+            OvalPixel(x1,y0,clip);
+            OvalPixel(x0,y0,clip);
+            OvalPixel(x0,y1,clip);
+            OvalPixel(x1,y1,clip);
+        }
+
+        e2 = 2 * err;
+        if (e2 <= dy) {
+            y0++;
+            y1--;
+            dy += a;
+            err += dy;
+        }
+        if ((e2 >= dx) || (2 * err > dy)) {
+            x0++;
+            x1--;
+            dx += b1;
+            err += dx;
+        }
+    } while (x0 <= x1);
+
+    while (y0 - y1 <= b) {
+        if (fill) {
+            OvalBar(x0-1,y1,y0,clip);
+            OvalBar(x1+1,y1,y0,clip);
+        } else {
+            OvalPixel(x0-1,y0,clip);
+            OvalPixel(x1+1,y0,clip);
+            OvalPixel(x0-1,y1,clip);
+            OvalPixel(x1+1,y1,clip);
+        }
+        ++y0;
+        --y1;
+    }
+}
+
+/*  Expected
+ *
+ *      Whether the pixel should be set after drawing the shape, or -1 if
+ *  either is allowed (the curve of a rounded corner)
+ */
+
+static int Expected(uint8_t shape, GDRect r, uint8_t corner, GDRect clip, int x, int y)
+{
+    if ((shape == SHAPE_OVAL) || (shape == SHAPE_FILLOVAL)) return Oval[y][x];
+    if (!Inside(x,y,clip) || !Inside(x,y,r)) return 0;
+    if (shape == SHAPE_PAINT) return 1;
+
+    int left = r.origin.x;
+    int top = r.origin.y;
+    int right = left + r.size.width - 1;
+    int bottom = top + r.size.height - 1;
+    bool edge = (x == left) || (x == right) || (y == top) || (y == bottom);
+
+    if (shape == SHAPE_ROUND) {
+        uint8_t maxr = (r.size.width < r.size.height ? r.size.width : r.size.height) >> 1;
+        if (corner > maxr) corner = maxr;
+
+        bool nearX = (x <= left + corner) || (x >= right - corner);
+        bool nearY = (y <= top + corner) || (y >= bottom - corner);
+        if (nearX && nearY) return -1;
+    }
+    return edge ? 1 : 0;
+}
+
+/*  Check
+ *
+ *      Draw a shape and check the result
+ */
+
+static void Check(uint8_t shape, GDRect r, uint8_t corner, GDRect clip)
+{
+    Display.clearClipRect();
+    Display.clear();
+    Display.writeDisplay();
+
+    Display.setClipRect(clip);
+    switch (shape) {
+        case SHAPE_PAINT:
+            Display.paintRect(r);
+            break;
+        case SHAPE_FRAME:
+            Display.frameRect(r);
+            break;
+        case SHAPE_ROUND:
+            Display.frameRoundRect(r,corner);
+            break;
+        case SHAPE_OVAL:
+            Display.frameOval(r);
+            OvalModel(r,false,clip);
+            break;
+        case SHAPE_FILLOVAL:
+            Display.paintOval(r);
+            OvalModel(r,true,clip);
+            break;
+    }
+    Display.writeDisplay();
+
+    int wrong = 0;
+    for (int y = 0; y < HEIGHT; ++y) {
+        for (int x = 0; x < WIDTH; ++x) {
+            int e = Expected(shape,r,corner,clip,x,y);
+            if ((e >= 0) && (e != (int)Display.pixel(x,y))) ++wrong;
+        }
+    }
+    bool synced = !memcmp(Emu.ram,Display.memory(),sizeof(Emu.ram));
+
+    if (wrong || !synced) {
+        if (++Failures <= 10) {
+            printf("FAIL %s {%d,%d,%d,%d} corner %d clip {%d,%d,%d,%d}: %d pixels wrong%s\n",
+                    ShapeName[shape],
+                    r.origin.x,r.origin.y,r.size.width,r.size.height,corner,
+                    clip.origin.x,clip.origin.y,clip.size.width,clip.size.height,
+                    wrong,synced ? "" : ", device differs");
+        }
+    }
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Tests																	*/
+/*																			*/
+/****************************************************************************/
+
+int main()
+{
+    static const GDRect full = { { 0, 0 }, { WIDTH, HEIGHT } };
+
+    SSD1306EmuInit(&Emu,SSD1306_I2C_ADDRESS);
+    TWIRecordSetHook(SSD1306EmuHook,&Emu);
+    Display.start();
+
+    /*
+     *  Rectangles running off the right and bottom, and past 255
+     */
+
+    for (uint8_t shape = SHAPE_PAINT; shape < SHAPES; ++shape) {
+        Check(shape,(GDRect){ { 100, 10 }, { 200, 20 } },4,full);
+        Check(shape,(GDRect){ { 10, 40 }, { 20, 250 } },4,full);
+        Check(shape,(GDRect){ { 120, 60 }, { 255, 255 } },4,full);
+        Check(shape,(GDRect){ { 200, 10 }, { 100, 20 } },4,full);
+        Check(shape,(GDRect){ { 0, 0 }, { 255, 255 } },8,full);
+        Check(shape,(GDRect){ { 100, 10 }, { 200, 20 } },4,(GDRect){ { 20, 5 }, { 90, 30 } });
+    }
+
+    /*
+     *  Random rectangles and clip rectangles
+     */
+
+    srand(1);
+    for (uint32_t i = 0; i < RANDOMTESTS; ++i) {
+        GDRect r,clip;
+
+        r.origin.x = rand() % 256;
+        r.origin.y = rand() % 256;
+        if (rand() % 2) {
+            r.origin.x %= WIDTH;
+            r.origin.y %= HEIGHT;
+        }
+        r.size.width = 1 + rand() % 255;
+        r.size.height = 1 + rand() % 255;
+
+        clip = full;
+        if (rand() % 3 == 0) {
+            clip.origin.x = rand() % WIDTH;
+            clip.origin.y = rand() % HEIGHT;
+            clip.size.width = 1 + rand() % (WIDTH - clip.origin.x);
+            clip.size.height = 1 + rand() % (HEIGHT - clip.origin.y);
+        }
+
+        Check(rand() % SHAPES,r,rand() % 12,clip);
+    }
+
+    printf("%s: %u failures\n",Failures ? "FAIL" : "PASS",Failures);
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,317 @@
+/*  consoletest.cpp
+ *
+ *      Host test for the text console. Random text, control characters,
+ *  cursor moves and clears to end of line are written to a console and to a
+ *  simple model of its grid, checking the cursor follows the model,
+ *  including deferred wrapping at the end of a line and scrolling at the
+ *  bottom. After each flush the device must match display memory, and
+ *  display memory must match the model drawn from scratch. From this
+ *  directory:
+ *
+ *      g++ -I. -I.. -o consoletest consoletest.cpp ssd1306emu.c \
+ *          twirecord.c ../console.cpp ../ssd1306.cpp ../display.cpp \
+ *          ../smallfont.cpp
+ *      ./consoletest
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssd1306.h"
+#include "ssd1306emu.h"
+#include "console.h"
+#include "fonts.h"
+#include "timers.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Constants																*/
+/*																			*/
+/****************************************************************************/
+
+#define WIDTH           128
+#define HEIGHT          64
+#define COLS            21              /* smallfont is 6x8 */
+#define ROWS            8
+#define CELLWIDTH       6
+#define CELLHEIGHT      8
+#define OPERATIONS      20000
+
+/****************************************************************************/
+/*																			*/
+/*	Timer Stand-ins															*/
+/*																			*/
+/****************************************************************************/
+
+uint32_t GetMilliseconds(void)
+{
+    return 0;
+}
+
+void DelayMilliseconds(uint16_t)
+{
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Test Support															*/
+/*																			*/
+/****************************************************************************/
+
+class Test: public SSD1306
+{
+    public:
+        const uint8_t *memory()
+                        {
+                            return display;
+                        }
+};
+
+static Test Display;
+static Test Reference;                  /* Never started or flushed */
+static SSD1306Emu Emu;
+static TextConsole Console(Display);
+static uint32_t Failures;
+
+#define CHECK(c)                                                    \
+    do {                                                            \
+        if (!(c)) {                                                 \
+            if (++Failures <= 10) printf("FAIL %s:%d: %s\n",__FILE__,__LINE__,#c); \
+        }                                                           \
+    } while (0)
+
+/*
+ *  Model of the console: the characters in each cell and the cursor, which
+ *  may sit one past the last column until the next character wraps it
+ */
+
+static char Grid[ROWS][COLS];
+static uint8_t Col;
+static uint8_t Row;
+
+static void ModelClear(void)
+{
+    memset(Grid,' ',sizeof(Grid));
+    Col = 0;
+    Row = 0;
+}
+
+static void ModelNewLine(void)
+{
+    Col = 0;
+    if (Row < ROWS - 1) {
+        ++Row;
+    } else {
+        memmove(Grid[0],Grid[1],(ROWS - 1) * COLS);
+        memset(Grid[ROWS - 1],' ',COLS);
+    }
+}
+
+static void ModelPutChar(char ch)
+{
+    switch (ch) {
+        case '\n':
+            ModelNewLine();
+            return;
+        case '\r':
+            Col = 0;
+            return;
+        case '\b':
+            if (Col > 0) --Col;
+            return;
+    }
+    if (Col >= COLS) ModelNewLine();
+    Grid[Row][Col++] = ch;
+}
+
+static void ModelClearToEOL(void)
+{
+    if (Col < COLS) memset(Grid[Row] + Col,' ',COLS - Col);
+}
+
+/*  Put
+ *
+ *      Write a character to the console and the model
+ */
+
+static void Put(char ch)
+{
+    Console.putChar(ch);
+    ModelPutChar(ch);
+}
+
+static void Print(const char *str)
+{
+    while (*str) Put(*str++);
+}
+
+/*  Compare
+ *
+ *      Flush the console and check the device, display memory and model
+ *  all agree. A second update must find nothing left to draw.
+ */
+
+static void Compare(const char *label)
+{
+    int8_t top = 0;
+    for (uint16_t i = 0; i <= smallfont.last - smallfont.first; ++i) {
+        if (top > smallfont.glyph[i].yOffset) top = smallfont.glyph[i].yOffset;
+    }
+
+    Console.flush();
+
+    Reference.clear();
+    Reference.setFont(&smallfont);
+    Reference.setDrawingMode(GL_WHITE);
+    for (uint8_t r = 0; r < ROWS; ++r) {
+        for (uint8_t c = 0; c < COLS; ++c) {
+            if (Grid[r][c] == ' ') continue;
+
+            GDRect cell = { { (uint8_t)(c * CELLWIDTH), (uint8_t)(r * CELLHEIGHT) }, { CELLWIDTH, CELLHEIGHT } };
+            Reference.setClipRect(cell);
+            Reference.moveTo((GDPoint){ cell.origin.x, (uint8_t)(cell.origin.y - top) });
+            Reference.drawChar(Grid[r][c]);
+        }
+    }
+    Reference.clearClipRect();
+
+    bool cursor = (Console.cursorCol() == Col) && (Console.cursorRow() == Row);
+    bool synced = !memcmp(Emu.ram,Display.memory(),sizeof(Emu.ram));
+    bool drawn = !memcmp(Reference.memory(),Display.memory(),sizeof(Emu.ram));
+    uint8_t redrawn = Console.update();
+
+    if (!cursor || !synced || !drawn || redrawn) {
+        if (++Failures <= 10) {
+            printf("FAIL %s: cursor %u,%u model %u,%u%s%s, %u redrawn\n",label,
+                    Console.cursorCol(),Console.cursorRow(),Col,Row,
+                    synced ? "" : ", device differs",
+                    drawn ? "" : ", drawing differs",redrawn);
+        }
+    }
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Tests																	*/
+/*																			*/
+/****************************************************************************/
+
+int main()
+{
+    static const GDRect full = { { 0, 0 }, { WIDTH, HEIGHT } };
+    char line[COLS + 1];
+
+    SSD1306EmuInit(&Emu,SSD1306_I2C_ADDRESS);
+    TWIRecordSetHook(SSD1306EmuHook,&Emu);
+
+    /*
+     *  The cursor can't be moved before start
+     */
+
+    Console.gotoXY(3,3);
+    CHECK((Console.cursorCol() == 0) && (Console.cursorRow() == 0));
+
+    Display.start();
+    CHECK(Console.start(&smallfont,full));
+    ModelClear();
+    Compare("start");
+
+    /*
+     *  A full line followed by a newline moves down one line, not two
+     */
+
+    memset(line,'a',COLS);
+    line[COLS] = 0;
+    Print(line);
+    CHECK((Console.cursorCol() == COLS) && (Console.cursorRow() == 0));
+    Put('\n');
+    CHECK((Console.cursorCol() == 0) && (Console.cursorRow() == 1));
+    Compare("full line");
+
+    /*
+     *  The next character after a full line wraps
+     */
+
+    Print(line);
+    Put('b');
+    CHECK((Console.cursorCol() == 1) && (Console.cursorRow() == 2));
+    Compare("wrap");
+
+    /*
+     *  Writing the bottom right cell doesn't scroll; the next character does
+     */
+
+    Console.gotoXY(COLS - 1,ROWS - 1);
+    Col = COLS - 1;
+    Row = ROWS - 1;
+    Put('Z');
+    CHECK((Console.cursorCol() == COLS) && (Console.cursorRow() == ROWS - 1));
+    Compare("bottom right");
+    CHECK(Grid[0][0] == 'a');
+
+    Put('Y');
+    CHECK((Console.cursorCol() == 1) && (Console.cursorRow() == ROWS - 1));
+    Compare("scroll");
+    CHECK(Grid[0][0] == 'a');           /* Was row 1 */
+    CHECK(Grid[ROWS - 2][COLS - 1] == 'Z');
+
+    /*
+     *  Clear to end of line, mid line and past the end
+     */
+
+    Console.gotoXY(5,1);
+    Col = 5;
+    Row = 1;
+    Console.clearToEOL();
+    ModelClearToEOL();
+    Compare("clear to end of line");
+
+    Console.gotoXY(0,3);
+    Col = 0;
+    Row = 3;
+    Print(line);
+    Console.clearToEOL();
+    ModelClearToEOL();
+    Compare("clear past end of line");
+
+    /*
+     *  gotoXY past the edges stops at the last cell
+     */
+
+    Console.gotoXY(200,200);
+    Col = COLS - 1;
+    Row = ROWS - 1;
+    Compare("goto past end");
+
+    /*
+     *  Random text, control characters, moves and clears
+     */
+
+    srand(1);
+    for (uint32_t i = 0; i < OPERATIONS; ++i) {
+        uint8_t op = rand() % 20;
+
+        if (op < 14) {
+            Put(' ' + rand() % 95);
+        } else if (op < 16) {
+            static const char control[] = { '\n', '\r', '\b' };
+            Put(control[rand() % 3]);
+        } else if (op < 18) {
+            uint8_t c = rand() % (COLS + 4);
+            uint8_t r = rand() % (ROWS + 2);
+            Console.gotoXY(c,r);
+            Col = (c < COLS) ? c : COLS - 1;
+            Row = (r < ROWS) ? r : ROWS - 1;
+        } else if (op < 19) {
+            Console.clearToEOL();
+            ModelClearToEOL();
+        } else {
+            Compare("random");
+        }
+    }
+    Compare("random");
+
+    printf("%s: %u failures\n",Failures ? "FAIL" : "PASS",Failures);
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,245 @@
+/*  drawbench.cpp
+ *
+ *      Host benchmark for the SSD1306 drawing primitives. Times
+ *  setPixelInternal, setHBarInternal and setVBarInternal in each drawing
+ *  mode against a copy of the earlier code, which switched on the drawing
+ *  mode for every byte it touched, and checks both draw the same thing.
+ *  From this directory:
+ *
+ *      g++ -O2 -I. -I.. -o drawbench drawbench.cpp twirecord.c \
+ *          ../ssd1306.cpp ../display.cpp
+ *      ./drawbench
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "ssd1306.h"
+#include "timers.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Constants																*/
+/*																			*/
+/****************************************************************************/
+
+#define WIDTH           128
+#define PAGES           8
+#define PASSES          2000
+
+/****************************************************************************/
+/*																			*/
+/*	Timer Stand-ins															*/
+/*																			*/
+/****************************************************************************/
+
+uint32_t GetMilliseconds(void)
+{
+    return 0;
+}
+
+void DelayMilliseconds(uint16_t)
+{
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Reference Code															*/
+/*																			*/
+/****************************************************************************/
+
+/*
+ *  The drawing primitives as they were before the drawing mode was resolved
+ *  once per primitive
+ */
+
+static uint8_t RefMemory[WIDTH * PAGES];
+static uint8_t RefMode;
+
+static void RefApply(uint16_t offset, uint8_t pattern)
+{
+    switch (RefMode) {
+        case GL_BLACK:
+            RefMemory[offset] &= ~pattern;
+            break;
+        default:
+        case GL_WHITE:
+            RefMemory[offset] |= pattern;
+            break;
+        case GL_XOR:
+            RefMemory[offset] ^= pattern;
+            break;
+    }
+}
+
+static void __attribute__((noinline)) RefPixel(uint8_t x, uint8_t y)
+{
+    RefApply(x + (y >> 3) * (uint16_t)WIDTH,1 << (y & 7));
+}
+
+static void __attribute__((noinline)) RefHBar(uint8_t left, uint8_t right, uint8_t y)
+{
+    uint8_t bit = 1 << (0x07 & y);
+    uint16_t offset = left + (y >> 3) * (uint16_t)WIDTH;
+    uint8_t i = left;
+
+    do {
+        RefApply(offset++,bit);
+    } while (i++ < right);
+}
+
+static void __attribute__((noinline)) RefVBar(uint8_t x, uint8_t top, uint8_t bottom)
+{
+    uint8_t pageTop = top >> 3;
+    uint8_t pageBottom = bottom >> 3;
+    uint8_t topPattern = 0xFF << (top & 0x07);
+    uint8_t bottomPattern = (0x02 << (bottom & 0x07)) - 1;
+    uint8_t i;
+
+    if (pageTop == pageBottom) {
+        RefApply(x + pageTop * (uint16_t)WIDTH,topPattern & bottomPattern);
+    } else {
+        RefApply(x + pageTop * (uint16_t)WIDTH,topPattern);
+        RefApply(x + pageBottom * (uint16_t)WIDTH,bottomPattern);
+        for (i = pageTop + 1; i < pageBottom; ++i) {
+            RefApply(x + i * (uint16_t)WIDTH,0xFF);
+        }
+    }
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Benchmark																*/
+/*																			*/
+/****************************************************************************/
+
+/*  Bench
+ *
+ *      Exposes the SSD1306 drawing primitives
+ */
+
+class Bench: public SSD1306
+{
+    public:
+        void        pixel(uint8_t x, uint8_t y)
+                        {
+                            setPixelInternal(x,y);
+                        }
+        void        hbar(uint8_t left, uint8_t right, uint8_t y)
+                        {
+                            setHBarInternal(left,right,y);
+                        }
+        void        vbar(uint8_t x, uint8_t top, uint8_t bottom)
+                        {
+                            setVBarInternal(x,top,bottom);
+                        }
+        uint8_t    *memory()
+                        {
+                            return display;
+                        }
+};
+
+static Bench Display;
+
+/*
+ *  The work each test does: a pass over every pixel, every row as a full
+ *  width bar, or every column as a full height bar, plus short bars
+ */
+
+#define TEST_PIXEL      0
+#define TEST_HBAR       1
+#define TEST_VBAR       2
+
+static void Draw(uint8_t test, bool reference)
+{
+    uint8_t x,y;
+
+    switch (test) {
+        case TEST_PIXEL:
+            for (y = 0; y < 64; ++y) {
+                for (x = 0; x < WIDTH; ++x) {
+                    if (reference) RefPixel(x,y);
+                    else Display.pixel(x,y);
+                }
+            }
+            break;
+        case TEST_HBAR:
+            for (y = 0; y < 64; ++y) {
+                if (reference) {
+                    RefHBar(0,WIDTH-1,y);
+                    RefHBar(y,y+5,y);
+                } else {
+                    Display.hbar(0,WIDTH-1,y);
+                    Display.hbar(y,y+5,y);
+                }
+            }
+            break;
+        case TEST_VBAR:
+            for (x = 0; x < WIDTH; ++x) {
+                if (reference) {
+                    RefVBar(x,0,63);
+                    RefVBar(x,x & 31,(x & 31) + 12);
+                } else {
+                    Display.vbar(x,0,63);
+                    Display.vbar(x,x & 31,(x & 31) + 12);
+                }
+            }
+            break;
+    }
+}
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*  Time
+ *
+ *      Nanoseconds per pass of the given test
+ */
+
+static double Time(uint8_t test, bool reference)
+{
+    Draw(test,reference);               /* Warm up */
+
+    double start = Now();
+    for (int i = 0; i < PASSES; ++i) Draw(test,reference);
+    return (Now() - start) / PASSES;
+}
+
+int main()
+{
+    static const char *testName[] = { "pixel", "hbar", "vbar" };
+    static const char *modeName[] = { "black", "white", "xor" };
+    static const uint8_t modes[] = { GL_BLACK, GL_WHITE, GL_XOR };
+    bool same = true;
+
+    printf("%-6s %-6s %12s %12s %8s\n","test","mode","before ns","after ns","gain");
+    for (uint8_t test = TEST_PIXEL; test <= TEST_VBAR; ++test) {
+        for (uint8_t m = 0; m < 3; ++m) {
+            /*
+             *  Start both from the same pattern so black and xor do work
+             */
+
+            for (uint16_t i = 0; i < sizeof(RefMemory); ++i) {
+                RefMemory[i] = (uint8_t)(i * 37);
+            }
+            memcpy(Display.memory(),RefMemory,sizeof(RefMemory));
+
+            RefMode = modes[m];
+            Display.setDrawingMode(modes[m]);
+
+            double before = Time(test,true);
+            double after = Time(test,false);
+            if (memcmp(Display.memory(),RefMemory,sizeof(RefMemory))) same = false;
+
+            printf("%-6s %-6s %12.0f %12.0f %7.2fx\n",testName[test],modeName[m],before,after,before / after);
+        }
+    }
+
+    printf("output %s\n",same ? "matches" : "DIFFERS");
+    return same ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+/*  glyphtest.cpp
+ *
+ *      Host test for the SSD1306 glyph cache, which is only compiled in when
+ *  SSD1306_GLYPHCACHE is set. Text drawn with a copy of smallfont without
+ *  its page data goes through the cache, and must match the same text drawn
+ *  from the page data, at random positions and clip rectangles. The hit and
+ *  miss counters are checked against the least recently used order. From
+ *  this directory:
+ *
+ *      g++ -DSSD1306_GLYPHCACHE=16 -I. -I.. -o glyphtest glyphtest.cpp \
+ *          twirecord.c ../ssd1306.cpp ../display.cpp ../smallfont.cpp
+ *      ./glyphtest
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssd1306.h"
+#include "fonts.h"
+#include "timers.h"
+
+#if SSD1306_GLYPHCACHE != 16
+#error Build with -DSSD1306_GLYPHCACHE=16
+#endif
+
+/****************************************************************************/
+/*																			*/
+/*	Constants																*/
+/*																			*/
+/****************************************************************************/
+
+#define WIDTH           128
+#define HEIGHT          64
+#define RANDOMTESTS     2000
+
+/****************************************************************************/
+/*																			*/
+/*	Timer Stand-ins															*/
+/*																			*/
+/****************************************************************************/
+
+uint32_t GetMilliseconds(void)
+{
+    return 0;
+}
+
+void DelayMilliseconds(uint16_t)
+{
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Test Support															*/
+/*																			*/
+/****************************************************************************/
+
+class Test: public SSD1306
+{
+    public:
+        const uint8_t *memory()
+                        {
+                            return display;
+                        }
+};
+
+static Test Cached;                     /* Draws smallfont through the cache */
+static Test Paged;                      /* Draws smallfont from page data */
+static GFXfont BitmapFont;              /* smallfont without page data */
+static uint32_t Failures;
+
+#define CHECK(c)                                                    \
+    do {                                                            \
+        if (!(c)) {                                                 \
+            printf("FAIL %s:%d: %s\n",__FILE__,__LINE__,#c);        \
+            ++Failures;                                             \
+        }                                                           \
+    } while (0)
+
+/*  Draw
+ *
+ *      Draw a string through the cache
+ */
+
+static void Draw(const char *str)
+{
+    Cached.moveTo((GDPoint){ 0, 8 });
+    Cached.drawString(str);
+}
+
+/*  Counters
+ *
+ *      True if the cache counters are as given
+ */
+
+static bool Counters(uint32_t hits, uint32_t misses)
+{
+    return (Cached.glyphCacheHits() == hits) && (Cached.glyphCacheMisses() == misses);
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Tests																	*/
+/*																			*/
+/****************************************************************************/
+
+/*  TestCounters
+ *
+ *      Hits and misses follow the least recently used order
+ */
+
+static void TestCounters(void)
+{
+    Cached.clearGlyphCache();
+    CHECK(Counters(0,0));
+
+    Draw("AB");
+    CHECK(Counters(0,2));
+    Draw("BA");
+    CHECK(Counters(2,2));
+
+    /*
+     *  Fill the cache: A..P. A is then used again, so B is the least
+     *  recently used and Q replaces it.
+     */
+
+    Cached.clearGlyphCache();
+    Draw("ABCDEFGHIJKLMNOP");
+    CHECK(Counters(0,16));
+    Draw("A");
+    CHECK(Counters(1,16));
+    Draw("Q");
+    CHECK(Counters(1,17));
+    Draw("A");
+    CHECK(Counters(2,17));
+    Draw("B");
+    CHECK(Counters(2,18));
+
+    /*
+     *  Clearing empties the cache
+     */
+
+    Cached.clearGlyphCache();
+    Draw("A");
+    CHECK(Counters(0,1));
+}
+
+/*  TestOutput
+ *
+ *      Random strings at random places draw the same through the cache as
+ *  from page data
+ */
+
+static void TestOutput(void)
+{
+    char str[12];
+    uint32_t wrong = 0;
+
+    Cached.clearGlyphCache();
+    srand(1);
+    for (uint32_t i = 0; i < RANDOMTESTS; ++i) {
+        uint8_t len = 1 + rand() % (sizeof(str) - 1);
+        for (uint8_t j = 0; j < len; ++j) str[j] = ' ' + rand() % 95;
+        str[len] = 0;
+
+        GDPoint pt = { (uint8_t)(rand() % WIDTH), (uint8_t)(rand() % (HEIGHT + 8)) };
+        GDRect clip = { { 0, 0 }, { WIDTH, HEIGHT } };
+        if (rand() % 3 == 0) {
+            clip.origin.x = rand() % WIDTH;
+            clip.origin.y = rand() % HEIGHT;
+            clip.size.width = 1 + rand() % (WIDTH - clip.origin.x);
+            clip.size.height = 1 + rand() % (HEIGHT - clip.origin.y);
+        }
+        uint8_t mode = (rand() % 2) ? GL_WHITE : GL_XOR;
+
+        Test *d[2] = { &Cached, &Paged };
+        for (uint8_t k = 0; k < 2; ++k) {
+            d[k]->setClipRect(clip);
+            d[k]->setDrawingMode(mode);
+            d[k]->moveTo(pt);
+            d[k]->drawString(str);
+        }
+
+        if (memcmp(Cached.memory(),Paged.memory(),WIDTH * HEIGHT / 8)) {
+            if (++wrong <= 5) printf("FAIL \"%s\" at %d,%d differs\n",str,pt.x,pt.y);
+        }
+    }
+    Failures += wrong;
+
+    /*
+     *  Random text repeats glyphs, so some hit; there are more glyphs than
+     *  entries, so some miss
+     */
+
+    uint32_t hits = Cached.glyphCacheHits();
+    uint32_t misses = Cached.glyphCacheMisses();
+    printf("cache: %u hits, %u misses\n",hits,misses);
+    CHECK((hits > 0) && (misses > 0));
+}
+
+int main()
+{
+    BitmapFont = smallfont;
+    BitmapFont.pageBitmap = NULL;
+    BitmapFont.pageOffset = NULL;
+
+    Cached.setFont(&BitmapFont);
+    Paged.setFont(&smallfont);
+    Cached.clear();
+    Paged.clear();
+
+    TestCounters();
+    Cached.clear();
+    Cached.clearClipRect();
+    TestOutput();
+
+    printf("%s: %u failures\n",Failures ? "FAIL" : "PASS",Failures);
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,271 @@
+/*  i2csim.c
+ *
+ *      Host simulation of the PIC32 I2C 1 peripheral
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <xc.h>
+#include "i2csim.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Registers																*/
+/*																			*/
+/****************************************************************************/
+
+volatile uint32_t I2C1CON;
+volatile uint32_t I2C1STAT;
+volatile uint32_t I2C1BRG;
+volatile uint32_t I2C1TRN;
+volatile uint32_t I2C1RCV;
+
+volatile uint32_t OSCCON;
+
+volatile uint32_t TRISB;
+volatile uint32_t LATB;
+volatile uint32_t PORTB;
+volatile uint32_t __CoreTimer;
+
+volatile uint32_t IFS1;
+volatile uint32_t IFS1CLR;
+volatile uint32_t IEC1;
+volatile uint32_t IPC8;
+
+/*
+ *  I2C1TRN holds this when nothing has been written to it. The driver only
+ *  ever writes a byte.
+ */
+
+#define TRN_EMPTY               0x100
+
+/****************************************************************************/
+/*																			*/
+/*	Globals 																*/
+/*																			*/
+/****************************************************************************/
+
+extern void IPC1Handler(void);
+
+static I2CSimDevice *SimDevice[I2CSIM_MAXDEVICES];
+static uint8_t SimDeviceCount;
+
+static I2CSimDevice *SimSelected;       /* Addressed device, or NULL */
+static bool SimAddressNext;             /* Next byte written is an address */
+static bool SimStalled;                 /* Peripheral has stopped responding */
+static bool SimOn;                      /* Module was on at last access */
+
+/****************************************************************************/
+/*																			*/
+/*	Setup   																*/
+/*																			*/
+/****************************************************************************/
+
+/*  I2CSimInit
+ *
+ *      Reset the registers and detach all devices
+ */
+
+void I2CSimInit(void)
+{
+    I2C1CON = 0;
+    I2C1STAT = 0;
+    I2C1BRG = 0;
+    I2C1TRN = TRN_EMPTY;
+    I2C1RCV = 0;
+    IFS1 = 0;
+    IFS1CLR = 0;
+    IEC1 = 0;
+    IPC8 = 0;
+    OSCCON = 3 << 19;                   /* PBDIV: peripheral clock is SYSCLK/8 */
+    TRISB = 0xFFFFFFFF;
+    LATB = 0;
+    PORTB = 0xFFFFFFFF;                 /* Pulled up */
+    __CoreTimer = 0;
+    
+    SimDeviceCount = 0;
+    SimStalled = false;
+    SimOn = false;
+    SimSelected = NULL;
+    SimAddressNext = false;
+}
+
+/*  I2CSimAttach
+ *
+ *      Attach a device to the bus
+ */
+
+bool I2CSimAttach(I2CSimDevice *device)
+{
+    if (SimDeviceCount >= I2CSIM_MAXDEVICES) return false;
+    SimDevice[SimDeviceCount++] = device;
+    return true;
+}
+
+/*  I2CSimStall
+ *
+ *      While stalled the peripheral does nothing, as if a slave were holding
+ *  the bus, so the driver's timeouts and recovery can be exercised. Turning
+ *  the module off (as recovery does) clears the stall, even if it is turned
+ *  straight back on.
+ */
+
+void I2CSimStall(bool stall)
+{
+    SimStalled = stall;
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Simulation																*/
+/*																			*/
+/****************************************************************************/
+
+/*  SimOff
+ *
+ *      The module has been turned off: abandon whatever it was doing
+ */
+
+static void SimOff(void)
+{
+    SimStalled = false;
+    SimSelected = NULL;
+    SimAddressNext = false;
+    I2C1TRN = TRN_EMPTY;
+}
+
+/*  I2CSimControl
+ *
+ *      Called (through I2C1CONbits in xc.h) before each bit field access to
+ *  I2C1CON. The driver turns the module off and on again within a single
+ *  call, which I2CSimStep would never see, so we watch for the ON bit having
+ *  been cleared since the last access.
+ */
+
+volatile uint32_t *I2CSimControl(void)
+{
+    bool on = (I2C1CON & 0x8000) != 0;  /* ON is bit 15 */
+    
+    if (SimOn && !on) SimOff();
+    SimOn = on;
+    return &I2C1CON;
+}
+
+/*  SimInterrupt
+ *
+ *      Raise the master interrupt and run the handler, then apply any writes
+ *  the handler made to IFS1CLR.
+ */
+
+static void SimInterrupt(void)
+{
+    IFS1bits.I2C1MIF = 1;
+    if (IEC1bits.I2C1MIE) IPC1Handler();
+    
+    IFS1 &= ~IFS1CLR;
+    IFS1CLR = 0;
+}
+
+/*  SimEndTransaction
+ *
+ *      Tell the selected device its transaction is over
+ */
+
+static void SimEndTransaction(void)
+{
+    if (SimSelected && SimSelected->stop) SimSelected->stop(SimSelected->context);
+    SimSelected = NULL;
+}
+
+/*  SimAddress
+ *
+ *      Handle an address byte: select the device, ACK or NAK
+ */
+
+static void SimAddress(uint8_t data)
+{
+    uint8_t i;
+    
+    SimSelected = NULL;
+    for (i = 0; i < SimDeviceCount; ++i) {
+        if (SimDevice[i]->address == (data >> 1)) {
+            SimSelected = SimDevice[i];
+            break;
+        }
+    }
+    
+    I2C1STATbits.ACKSTAT = (SimSelected == NULL);
+    if (SimSelected && SimSelected->start) {
+        SimSelected->start(SimSelected->context,(data & 1) != 0);
+    }
+}
+
+/*  I2CSimStep
+ *
+ *      Perform the next action requested of the peripheral and run the
+ *  interrupt handler. Returns false if there is nothing to do.
+ */
+
+bool I2CSimStep(void)
+{
+    if (!I2C1CONbits.ON) {
+        SimOff();
+        return false;
+    }
+    if (SimStalled) return false;
+    
+    if (I2C1CONbits.SEN) {
+        I2C1CONbits.SEN = 0;
+        SimAddressNext = true;
+    } else if (I2C1CONbits.RSEN) {
+        I2C1CONbits.RSEN = 0;
+        SimEndTransaction();
+        SimAddressNext = true;
+    } else if (I2C1CONbits.PEN) {
+        I2C1CONbits.PEN = 0;
+        SimEndTransaction();
+    } else if (I2C1TRN != TRN_EMPTY) {
+        uint8_t data = (uint8_t)I2C1TRN;
+        I2C1TRN = TRN_EMPTY;
+        
+        if (SimAddressNext) {
+            SimAddressNext = false;
+            SimAddress(data);
+        } else if (SimSelected == NULL) {
+            I2C1STATbits.ACKSTAT = 1;
+        } else if (SimSelected->write) {
+            I2C1STATbits.ACKSTAT = !SimSelected->write(SimSelected->context,data);
+        } else {
+            I2C1STATbits.ACKSTAT = 0;
+        }
+    } else if (I2C1CONbits.RCEN) {
+        I2C1CONbits.RCEN = 0;
+        if (SimSelected && SimSelected->read) {
+            I2C1RCV = SimSelected->read(SimSelected->context);
+        } else {
+            I2C1RCV = 0xFF;
+        }
+        I2C1STATbits.RBF = 1;
+    } else if (I2C1CONbits.ACKEN) {
+        I2C1CONbits.ACKEN = 0;
+        I2C1STATbits.RBF = 0;
+    } else {
+        return false;
+    }
+    
+    SimInterrupt();
+    return true;
+}
+
+/*  I2CSimRun
+ *
+ *      Step until the peripheral is idle. Returns the number of steps.
+ */
+
+uint32_t I2CSimRun(void)
+{
+    uint32_t steps = 0;
+    
+    while (I2CSimStep()) ++steps;
+    return steps;
+}
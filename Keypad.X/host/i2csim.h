@@ -0,0 +1,68 @@
+/*  i2csim.h
+ *
+ *      Host simulation of the PIC32 I2C 1 peripheral, so the I2C driver and
+ *  its transfer queue can be run on a desktop machine. The simulator reacts
+ *  to the control bits the driver sets (SEN, RSEN, PEN, RCEN, ACKEN) and to
+ *  writes of I2C1TRN, one action per step, raising the master interrupt
+ *  and calling the driver's interrupt handler as the hardware would.
+ *
+ *      Simulated devices are attached by address. There is no other thread,
+ *  so the synchronous TWIWrite and TWIRead would wait forever: use the
+ *  asynchronous calls and then I2CSimRun. The driver's timeouts read
+ *  GetMilliseconds, which the test program supplies. i2ctest.c is an
+ *  example; from this directory:
+ *
+ *      gcc -I. -I.. -o i2ctest i2ctest.c i2csim.c ../i2c.c
+ */
+
+#ifndef _I2CSIM_H
+#define _I2CSIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************/
+/*																			*/
+/*	Devices 																*/
+/*																			*/
+/****************************************************************************/
+
+/*  I2CSimDevice
+ *
+ *      A simulated slave. Any callback may be NULL; a device with no write
+ *  callback ACKs every byte, and one with no read callback reads as 0xFF.
+ */
+
+typedef struct I2CSimDevice {
+    uint8_t address;                                /* 7 bit address */
+    void (*start)(void *context, bool read);        /* Addressed */
+    bool (*write)(void *context, uint8_t data);     /* Return false to NAK */
+    uint8_t (*read)(void *context);
+    void (*stop)(void *context);                    /* Stop or restart */
+    void *context;
+} I2CSimDevice;
+
+#define I2CSIM_MAXDEVICES       4
+
+/****************************************************************************/
+/*																			*/
+/*	Routines																*/
+/*																			*/
+/****************************************************************************/
+
+extern void I2CSimInit(void);
+extern bool I2CSimAttach(I2CSimDevice *device);
+extern void I2CSimStall(bool stall);
+
+extern bool I2CSimStep(void);
+extern uint32_t I2CSimRun(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _I2CSIM_H */
@@ -0,0 +1,404 @@
+/*  i2ctest.c
+ *
+ *      Host test for the I2C driver's transfer queue and its timeout
+ *  recovery, run against the simulated peripheral. From this directory:
+ *
+ *      gcc -I. -I.. -o i2ctest i2ctest.c i2csim.c ../i2c.c
+ *      ./i2ctest
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "i2csim.h"
+#include "i2c.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Constants																*/
+/*																			*/
+/****************************************************************************/
+
+#define DEVICE_ADDRESS      0x3C
+#define ABSENT_ADDRESS      0x3D
+#define NAK_BYTE            0xEE        /* Device NAKs this byte */
+
+#define MAXLOG              256
+#define MAXRESULTS          32
+
+/****************************************************************************/
+/*																			*/
+/*	Globals 																*/
+/*																			*/
+/****************************************************************************/
+
+static uint32_t Failures;
+
+#define CHECK(c)                                                    \
+    do {                                                            \
+        if (!(c)) {                                                 \
+            printf("FAIL %s:%d: %s\n",__FILE__,__LINE__,#c);        \
+            ++Failures;                                             \
+        }                                                           \
+    } while (0)
+
+/*
+ *  What the simulated device saw
+ */
+
+static uint8_t Log[MAXLOG];
+static uint16_t LogLength;
+static uint16_t Starts;
+static uint16_t Stops;
+static uint8_t ReadValue;
+
+/*
+ *  Completion callbacks, in order
+ */
+
+static int8_t Result[MAXRESULTS];
+static uint8_t ResultCount;
+
+/****************************************************************************/
+/*																			*/
+/*	Timer Stand-in															*/
+/*																			*/
+/****************************************************************************/
+
+static uint32_t Now;
+
+uint32_t GetMilliseconds(void)
+{
+    return Now;
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Simulated Device														*/
+/*																			*/
+/****************************************************************************/
+
+static void DeviceStart(void *context, bool read)
+{
+    (void)context;
+    (void)read;
+    ++Starts;
+}
+
+static bool DeviceWrite(void *context, uint8_t data)
+{
+    (void)context;
+    if (LogLength < MAXLOG) Log[LogLength++] = data;
+    return data != NAK_BYTE;
+}
+
+static uint8_t DeviceRead(void *context)
+{
+    (void)context;
+    return ReadValue++;
+}
+
+static void DeviceStop(void *context)
+{
+    (void)context;
+    ++Stops;
+}
+
+static I2CSimDevice Device = {
+    DEVICE_ADDRESS, DeviceStart, DeviceWrite, DeviceRead, DeviceStop, NULL
+};
+
+/****************************************************************************/
+/*																			*/
+/*	Test Support															*/
+/*																			*/
+/****************************************************************************/
+
+/*  Reset
+ *
+ *      Start each test with a fresh peripheral, device and driver
+ */
+
+static void Reset(void)
+{
+    I2CSimInit();
+    I2CSimAttach(&Device);
+    TWIInit(TWI_FREQ);
+
+    LogLength = 0;
+    Starts = 0;
+    Stops = 0;
+    ReadValue = 0x10;
+    ResultCount = 0;
+    Now = 0;
+}
+
+static void Record(int8_t status, void *context)
+{
+    (void)context;
+    if (ResultCount < MAXRESULTS) Result[ResultCount++] = status;
+}
+
+/*
+ *  Queues one more write from inside its completion callback
+ */
+
+static const uint8_t Chained[3] = { 9, 8, 7 };
+
+static void RecordAndChain(int8_t status, void *context)
+{
+    Record(status,context);
+    TWIWriteAsync(DEVICE_ADDRESS,Chained,sizeof(Chained),true,Record,NULL);
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Queue Tests																*/
+/*																			*/
+/****************************************************************************/
+
+/*  TestQueueOrder
+ *
+ *      Queued writes run back to back, in order, each as its own transaction
+ */
+
+static void TestQueueOrder(void)
+{
+    static const uint8_t a[3] = { 1, 2, 3 };
+    static const uint8_t b[2] = { 4, 5 };
+    static const uint8_t c[1] = { 6 };
+
+    Reset();
+    CHECK(TWIWriteAsync(DEVICE_ADDRESS,a,sizeof(a),true,Record,NULL) == TWI_SUCCESS);
+    CHECK(TWIWriteAsync(DEVICE_ADDRESS,b,sizeof(b),true,Record,NULL) == TWI_SUCCESS);
+    CHECK(TWIWriteAsync(DEVICE_ADDRESS,c,sizeof(c),true,Record,NULL) == TWI_SUCCESS);
+    CHECK(TWIIsBusy());
+
+    I2CSimRun();
+
+    CHECK(!TWIIsBusy());
+    CHECK(ResultCount == 3);
+    CHECK((Result[0] == TWI_SUCCESS) && (Result[1] == TWI_SUCCESS) && (Result[2] == TWI_SUCCESS));
+    CHECK(Starts == 3);
+    CHECK(Stops == 3);
+    CHECK(LogLength == 6);
+    CHECK((Log[0] == 1) && (Log[2] == 3) && (Log[3] == 4) && (Log[5] == 6));
+}
+
+/*  TestErrors
+ *
+ *      An address or data NAK fails that transfer only
+ */
+
+static void TestErrors(void)
+{
+    static const uint8_t good[2] = { 1, 2 };
+    static const uint8_t nak[3] = { 1, NAK_BYTE, 2 };
+    TWIStats stats;
+
+    Reset();
+    TWIClearStats();
+    TWIWriteAsync(ABSENT_ADDRESS,good,sizeof(good),true,Record,NULL);
+    TWIWriteAsync(DEVICE_ADDRESS,nak,sizeof(nak),true,Record,NULL);
+    TWIWriteAsync(DEVICE_ADDRESS,good,sizeof(good),true,Record,NULL);
+    I2CSimRun();
+
+    CHECK(ResultCount == 3);
+    CHECK(Result[0] == TWI_ERROR_WRITE_ADDRESS);
+    CHECK(Result[1] == TWI_ERROR_WRITE_DATA);
+    CHECK(Result[2] == TWI_SUCCESS);
+    CHECK(!TWIIsBusy());
+
+    TWIGetStats(&stats);
+    CHECK(stats.nakAddress == 1);
+    CHECK(stats.nakData == 1);
+}
+
+/*  TestQueueFull
+ *
+ *      The queue holds TWI_QUEUESIZE transfers and refuses more
+ */
+
+static void TestQueueFull(void)
+{
+    static const uint8_t data[1] = { 1 };
+    uint8_t i;
+
+    Reset();
+    for (i = 0; i < TWI_QUEUESIZE; ++i) {
+        CHECK(TWIWriteAsync(DEVICE_ADDRESS,data,1,true,Record,NULL) == TWI_SUCCESS);
+    }
+    CHECK(TWIWriteAsync(DEVICE_ADDRESS,data,1,true,Record,NULL) == TWI_ERROR_QUEUE_FULL);
+
+    I2CSimRun();
+    CHECK(ResultCount == TWI_QUEUESIZE);
+    CHECK(!TWIIsBusy());
+    CHECK(TWIWriteAsync(DEVICE_ADDRESS,data,1,true,Record,NULL) == TWI_SUCCESS);
+    I2CSimRun();
+    CHECK(ResultCount == TWI_QUEUESIZE + 1);
+}
+
+/*  TestChain
+ *
+ *      A callback may queue another transfer, which then runs
+ */
+
+static void TestChain(void)
+{
+    static const uint8_t data[2] = { 1, 2 };
+
+    Reset();
+    TWIWriteAsync(DEVICE_ADDRESS,data,sizeof(data),true,RecordAndChain,NULL);
+    I2CSimRun();
+
+    CHECK(ResultCount == 2);
+    CHECK((Result[0] == TWI_SUCCESS) && (Result[1] == TWI_SUCCESS));
+    CHECK(LogLength == 5);
+    CHECK((Log[2] == 9) && (Log[4] == 7));
+    CHECK(!TWIIsBusy());
+}
+
+/*  TestRead
+ *
+ *      Asynchronous reads fill the buffer with what the device sends
+ */
+
+static void TestRead(void)
+{
+    uint8_t buffer[4];
+    TWIStatus status = { false, 0 };
+
+    Reset();
+    memset(buffer,0,sizeof(buffer));
+    CHECK(TWIReadAsync(DEVICE_ADDRESS,buffer,sizeof(buffer),true,TWIStatusCallback,&status) == TWI_SUCCESS);
+    I2CSimRun();
+
+    CHECK(status.done);
+    CHECK(status.status == TWI_SUCCESS);
+    CHECK((buffer[0] == 0x10) && (buffer[3] == 0x13));
+}
+
+/*  TestVectored
+ *
+ *      The segments of a vectored write go out as one transaction
+ */
+
+static void TestVectored(void)
+{
+    static const uint8_t control[1] = { 0x40 };
+    static const uint8_t data[3] = { 1, 2, 3 };
+    static const uint8_t more[2] = { 4, 5 };
+    TWISegment seg[3] = { { control, 1 }, { data, 3 }, { more, 2 } };
+
+    Reset();
+    CHECK(TWIEnqueuev(DEVICE_ADDRESS,seg,3,TWI_FLAG_STOP,Record,NULL) == TWI_SUCCESS);
+    I2CSimRun();
+
+    CHECK(ResultCount == 1);
+    CHECK(Result[0] == TWI_SUCCESS);
+    CHECK(Starts == 1);
+    CHECK(LogLength == 6);
+    CHECK((Log[0] == 0x40) && (Log[1] == 1) && (Log[5] == 5));
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Recovery Tests															*/
+/*																			*/
+/****************************************************************************/
+
+/*  TestTimeout
+ *
+ *      A transfer which stalls is failed with TWI_ERROR_TIMEOUT once its
+ *  deadline passes, along with everything queued behind it; the bus is
+ *  recovered, and a transfer queued by a failing callback then runs.
+ */
+
+static void TestTimeout(void)
+{
+    static const uint8_t data[2] = { 1, 2 };
+    TWIStats stats;
+
+    Reset();
+    TWIClearStats();
+    I2CSimStall(true);
+
+    TWIWriteAsync(DEVICE_ADDRESS,data,sizeof(data),true,Record,NULL);
+    TWIWriteAsync(DEVICE_ADDRESS,data,sizeof(data),true,RecordAndChain,NULL);
+    I2CSimRun();
+    CHECK(ResultCount == 0);
+
+    TWIService();                       /* Not yet expired */
+    CHECK(ResultCount == 0);
+    CHECK(TWIIsBusy());
+
+    Now += TWI_TIMEOUT + 10;
+    TWIService();
+
+    CHECK(ResultCount == 2);
+    CHECK((Result[0] == TWI_ERROR_TIMEOUT) && (Result[1] == TWI_ERROR_TIMEOUT));
+
+    TWIGetStats(&stats);
+    CHECK(stats.timeout == 1);
+    CHECK(stats.recovery == 1);
+
+    /*
+     *  Recovery turned the module off, which clears the stall, so the
+     *  chained write now runs
+     */
+
+    I2CSimRun();
+    CHECK(ResultCount == 3);
+    CHECK(Result[2] == TWI_SUCCESS);
+    CHECK(LogLength == 3);
+    CHECK(Log[0] == 9);
+    CHECK(!TWIIsBusy());
+}
+
+/*  TestAfterTimeout
+ *
+ *      Transfers queued after a recovery run normally
+ */
+
+static void TestAfterTimeout(void)
+{
+    static const uint8_t data[2] = { 1, 2 };
+
+    Reset();
+    I2CSimStall(true);
+    TWIWriteAsync(DEVICE_ADDRESS,data,sizeof(data),true,Record,NULL);
+    Now += TWI_TIMEOUT + 10;
+    TWIService();
+    CHECK(ResultCount == 1);
+    CHECK(Result[0] == TWI_ERROR_TIMEOUT);
+
+    TWIWriteAsync(DEVICE_ADDRESS,data,sizeof(data),true,Record,NULL);
+    TWIWriteAsync(DEVICE_ADDRESS,data,sizeof(data),true,Record,NULL);
+    I2CSimRun();
+    CHECK(ResultCount == 3);
+    CHECK((Result[1] == TWI_SUCCESS) && (Result[2] == TWI_SUCCESS));
+    CHECK(LogLength == 4);
+    CHECK(!TWIIsBusy());
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Main																	*/
+/*																			*/
+/****************************************************************************/
+
+int main(void)
+{
+    TestQueueOrder();
+    TestErrors();
+    TestQueueFull();
+    TestChain();
+    TestRead();
+    TestVectored();
+    TestTimeout();
+    TestAfterTimeout();
+
+    printf("%s: %u failures\n",Failures ? "FAIL" : "PASS",Failures);
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,169 @@
+/*  pagefont.cpp
+ *
+ *      Host tool which adds page organized glyph data to a GFXfont. The
+ *  SSD1306 stores each column of 8 pixels as a byte, so if each glyph is also
+ *  stored as column bytes, drawing page aligned text becomes a byte copy.
+ *
+ *      The font source is compiled into this tool, and a new font source is
+ *  written to stdout containing the original bitmap and glyph tables plus the
+ *  page data. To regenerate smallfont.cpp, from this directory:
+ *
+ *      g++ -I.. -DFONT_SOURCE='"../smallfont.cpp"' -DFONT_NAME=smallfont \
+ *          -o pagefont pagefont.cpp
+ *      ./pagefont > ../smallfont.cpp.new && mv ../smallfont.cpp.new ../smallfont.cpp
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include FONT_SOURCE
+
+/****************************************************************************/
+/*																			*/
+/*	Constants       														*/
+/*																			*/
+/****************************************************************************/
+
+#define STRINGIFY(x)        #x
+#define NAME(x)             STRINGIFY(x)
+
+/****************************************************************************/
+/*																			*/
+/*	Conversion      														*/
+/*																			*/
+/****************************************************************************/
+
+/*  ConvertGlyph
+ *
+ *      Convert the row-major bit packed glyph into page organized column
+ *  bytes: ((height + 7) / 8) rows of width bytes, LSB at the top. Returns the
+ *  number of bytes written.
+ */
+
+static uint16_t ConvertGlyph(const GFXfont *font, const GFXglyph *g, uint8_t *out)
+{
+    uint8_t pages = (g->height + 7) >> 3;
+    uint16_t size = g->width * (uint16_t)pages;
+    uint16_t bitIndex = 0;
+    
+    memset(out,0,size);
+    for (uint8_t y = 0; y < g->height; ++y) {
+        for (uint8_t x = 0; x < g->width; ++x) {
+            uint8_t b = 0x80 >> (bitIndex & 7);
+            uint16_t n = (bitIndex >> 3) + g->bitmapOffset;
+            if (font->bitmap[n] & b) {
+                out[x + (y >> 3) * g->width] |= 1 << (y & 7);
+            }
+            ++bitIndex;
+        }
+    }
+    return size;
+}
+
+/*  WriteBytes
+ *
+ *      Write an array of bytes, eight per line
+ */
+
+static void WriteBytes(const char *name, const uint8_t *data, uint32_t len)
+{
+    printf("const uint8_t %s[] = {\n", name);
+    for (uint32_t i = 0; i < len; ++i) {
+        if ((i & 7) == 0) printf("    ");
+        printf("0x%02X", data[i]);
+        if (i + 1 < len) printf(((i & 7) == 7) ? ",\n" : ", ");
+    }
+    printf("\n};\n\n");
+}
+
+/*  GlyphName
+ *
+ *      Comment used to label each glyph
+ */
+
+static const char *GlyphName(uint16_t c)
+{
+    static char buffer[8];
+    if (c == ' ') return "sp";
+    snprintf(buffer,sizeof(buffer),"'%c'",(char)c);
+    return buffer;
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Main            														*/
+/*																			*/
+/****************************************************************************/
+
+int main()
+{
+    const GFXfont *font = &FONT_NAME;
+    uint16_t count = font->last - font->first + 1;
+    static uint8_t pageBitmap[65536];
+    static uint16_t pageOffset[65536];
+    uint32_t bitmapLength = 0;
+    uint32_t pageLength = 0;
+    
+    /*
+     *  Convert the glyphs
+     */
+    
+    for (uint16_t i = 0; i < count; ++i) {
+        const GFXglyph *g = font->glyph + i;
+        uint32_t end = g->bitmapOffset + (g->width * (uint32_t)g->height + 7) / 8;
+        if (bitmapLength < end) bitmapLength = end;
+        
+        pageOffset[i] = pageLength;
+        pageLength += ConvertGlyph(font,g,pageBitmap + pageLength);
+        if (pageLength > 65535) {
+            fprintf(stderr,"Page data too large\n");
+            return 1;
+        }
+    }
+    
+    /*
+     *  Write the new font source
+     */
+    
+    printf("/*  %s.cpp\n", NAME(FONT_NAME));
+    printf(" *\n");
+    printf(" *      %s automatically generated by AdaFontEditor. Page organized\n", NAME(FONT_NAME));
+    printf(" *  glyph data added by host/pagefont.\n");
+    printf(" */\n\n");
+    printf("#include \"fonts.h\"\n\n\n");
+    
+    WriteBytes(NAME(FONT_NAME) "_bitmap",font->bitmap,bitmapLength);
+    
+    printf("const GFXglyph %s_glyphs[] = {\n", NAME(FONT_NAME));
+    for (uint16_t i = 0; i < count; ++i) {
+        const GFXglyph *g = font->glyph + i;
+        printf("    { %5u, %3u, %3u, %3u, %3d, %3d }%s  // %s\n",
+               g->bitmapOffset, g->width, g->height, g->xAdvance,
+               g->xOffset, g->yOffset, (i + 1 < count) ? "," : " ",
+               GlyphName(font->first + i));
+    }
+    printf("};\n\n");
+    
+    WriteBytes(NAME(FONT_NAME) "_pagebitmap",pageBitmap,pageLength);
+    
+    printf("const uint16_t %s_pageoffset[] = {\n", NAME(FONT_NAME));
+    for (uint16_t i = 0; i < count; ++i) {
+        if ((i & 7) == 0) printf("    ");
+        printf("%5u", pageOffset[i]);
+        if (i + 1 < count) printf(((i & 7) == 7) ? ",\n" : ", ");
+    }
+    printf("\n};\n\n");
+    
+    printf("const GFXfont %s = {\n", NAME(FONT_NAME));
+    printf("    %s_bitmap,\n", NAME(FONT_NAME));
+    printf("    %s_glyphs,\n", NAME(FONT_NAME));
+    printf("    %u,\n", font->first);
+    printf("    %u,\n", font->last);
+    printf("    %u,\n", font->yAdvance);
+    printf("    %s_pagebitmap,\n", NAME(FONT_NAME));
+    printf("    %s_pageoffset\n", NAME(FONT_NAME));
+    printf("};\n\n");
+    
+    return 0;
+}
@@ -0,0 +1,194 @@
+/*  plantest.cpp
+ *
+ *      Host test for SSD1306 flush planning. Random frames are drawn and
+ *  flushed with writeDisplay at several bus speeds, with and without diff
+ *  mode and high and low priority areas, and the bytes and transactions
+ *  flushPlan predicted are checked against what was actually sent. The
+ *  emulator checks the device still matches display memory. From this
+ *  directory:
+ *
+ *      g++ -I. -I.. -o plantest plantest.cpp ssd1306emu.c twirecord.c \
+ *          ../ssd1306.cpp ../display.cpp
+ *      ./plantest
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssd1306.h"
+#include "ssd1306emu.h"
+#include "timers.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Constants																*/
+/*																			*/
+/****************************************************************************/
+
+#define WIDTH           128
+#define HEIGHT          64
+#define FRAMES          2000
+
+/****************************************************************************/
+/*																			*/
+/*	Timer Stand-ins															*/
+/*																			*/
+/****************************************************************************/
+
+static uint32_t Now;
+
+uint32_t GetMilliseconds(void)
+{
+    return Now;
+}
+
+void DelayMilliseconds(uint16_t)
+{
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Test Support															*/
+/*																			*/
+/****************************************************************************/
+
+class Test: public SSD1306
+{
+    public:
+        const uint8_t *memory()
+                        {
+                            return display;
+                        }
+};
+
+static Test Display;
+static SSD1306Emu Emu;
+static uint32_t Failures;
+
+static const char *StrategyName[] = { "diff", "windows", "full" };
+
+/*  RandomFrame
+ *
+ *      Draw a few random rectangles, mostly small. Now and then draw full
+ *  width bands which straddle pages, so that sending the whole display is
+ *  the cheapest plan.
+ */
+
+static void RandomFrame(void)
+{
+    uint8_t n = 1 + rand() % 6;
+
+    if (rand() % 10 == 0) {
+        Display.setDrawingMode(GL_XOR);
+        for (uint8_t i = 0; i < 4; ++i) {
+            Display.paintRect((GDRect){ { 0, (uint8_t)(i * 16 + 4 + rand() % 4) }, { WIDTH, (uint8_t)(8 + rand() % 4) } });
+        }
+        return;
+    }
+
+    for (uint8_t i = 0; i < n; ++i) {
+        GDRect r;
+        uint8_t big = (rand() % 8 == 0) ? 4 : 1;
+        if (rand() % 20 == 0) big = 12;
+
+        r.origin.x = rand() % WIDTH;
+        r.origin.y = rand() % HEIGHT;
+        r.size.width = 1 + rand() % (12 * big);
+        r.size.height = 1 + rand() % (6 * big);
+
+        Display.setDrawingMode((rand() % 3 == 0) ? GL_WHITE : GL_XOR);
+        Display.paintRect(r);
+    }
+}
+
+/*  RandomAreas
+ *
+ *      Replace the priority areas with up to three random ones
+ */
+
+static void RandomAreas(void)
+{
+    uint8_t n = rand() % 4;
+
+    Display.clearPriorities();
+    for (uint8_t i = 0; i < n; ++i) {
+        GDRect r;
+
+        r.origin.x = rand() % WIDTH;
+        r.origin.y = rand() % HEIGHT;
+        r.size.width = 1 + rand() % (WIDTH - r.origin.x);
+        r.size.height = 1 + rand() % (HEIGHT - r.origin.y);
+        Display.setPriority(r,(rand() % 2) ? SSD1306_PRIORITY_HIGH : SSD1306_PRIORITY_LOW);
+    }
+}
+
+/*  Flush
+ *
+ *      Flush the display, checking the plan against what was sent
+ */
+
+static void Flush(const char *label)
+{
+    SSD1306Plan predicted = Display.flushPlan();
+    uint32_t bytes = TWIRecordBytes();
+    uint32_t count = TWIRecordCount();
+
+    Display.writeDisplay();
+    ++Now;
+
+    bytes = TWIRecordBytes() - bytes;
+    count = TWIRecordCount() - count;
+
+    const SSD1306Plan &used = Display.lastPlan();
+    bool synced = !memcmp(Emu.ram,Display.memory(),sizeof(Emu.ram));
+
+    if ((predicted.bytes != bytes) || (predicted.transactions != count) ||
+            (used.strategy != predicted.strategy) || (used.bytes != bytes) || !synced) {
+        if (++Failures <= 10) {
+            printf("FAIL %s: %s plan %u bytes/%u transactions, sent %u/%u%s\n",
+                    label,StrategyName[predicted.strategy],
+                    predicted.bytes,predicted.transactions,bytes,count,
+                    synced ? "" : ", device differs");
+        }
+    }
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Tests																	*/
+/*																			*/
+/****************************************************************************/
+
+int main()
+{
+    static const uint32_t freq[] = { TWI_FREQ, TWI_FREQ_FAST, TWI_FREQ_FASTPLUS };
+    uint32_t strategies[3] = { 0, 0, 0 };
+    char label[32];
+
+    SSD1306EmuInit(&Emu,SSD1306_I2C_ADDRESS);
+    TWIRecordSetHook(SSD1306EmuHook,&Emu);
+
+    srand(1);
+    for (uint8_t f = 0; f < 3; ++f) {
+        for (uint8_t diff = 0; diff < 2; ++diff) {
+            TWIInit(freq[f]);
+            Display.start();
+            Display.setDiffMode(diff);
+            Display.writeDisplay();
+
+            sprintf(label,"%uk %s",(unsigned)(freq[f] / 1000),diff ? "diff" : "windows");
+            for (uint32_t i = 0; i < FRAMES; ++i) {
+                if (i % 100 == 0) RandomAreas();
+                RandomFrame();
+                ++strategies[Display.flushPlan().strategy];
+                Flush(label);
+            }
+        }
+    }
+    Display.clearPriorities();
+
+    printf("plans: %u diff, %u windows, %u full\n",strategies[0],strategies[1],strategies[2]);
+    printf("%s: %u failures\n",Failures ? "FAIL" : "PASS",Failures);
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,477 @@
+/*  ssd1306emu.c
+ *
+ *      Host emulation of the SSD1306 controller
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "ssd1306emu.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Setup   																*/
+/*																			*/
+/****************************************************************************/
+
+/*  SSD1306EmuInit
+ *
+ *      Reset the controller to its power on state. Display memory is
+ *  cleared, though on the real part it starts out random.
+ */
+
+void SSD1306EmuInit(SSD1306Emu *emu, uint8_t address)
+{
+    memset(emu,0,sizeof(SSD1306Emu));
+    emu->address = address;
+    
+    emu->memoryMode = SSD1306EMU_PAGE;
+    emu->columnEnd = SSD1306EMU_WIDTH - 1;
+    emu->pageEnd = SSD1306EMU_PAGES - 1;
+    emu->multiplex = SSD1306EMU_HEIGHT - 1;
+    emu->contrast = 0x7F;
+}
+
+/*  SSD1306EmuClearCounters
+ *
+ *      Reset the transaction and byte counters
+ */
+
+void SSD1306EmuClearCounters(SSD1306Emu *emu)
+{
+    emu->transactions = 0;
+    emu->bytes = 0;
+    emu->controlBytes = 0;
+    emu->commandBytes = 0;
+    emu->dataBytes = 0;
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Commands																*/
+/*																			*/
+/****************************************************************************/
+
+/*  CommandArguments
+ *
+ *      The number of argument bytes which follow a command
+ */
+
+static uint8_t CommandArguments(uint8_t cmd)
+{
+    switch (cmd) {
+        case 0x20:                      /* Memory mode */
+        case 0x23:                      /* Fade out and blinking */
+        case 0x81:                      /* Contrast */
+        case 0x82:                      /* Brightness */
+        case 0x8D:                      /* Charge pump */
+        case 0xA8:                      /* Multiplex ratio */
+        case 0xD3:                      /* Display offset */
+        case 0xD5:                      /* Clock divide */
+        case 0xD6:                      /* Zoom */
+        case 0xD9:                      /* Precharge */
+        case 0xDA:                      /* COM pins */
+        case 0xDB:                      /* VCOMH level */
+            return 1;
+        case 0x21:                      /* Column address */
+        case 0x22:                      /* Page address */
+        case 0xA3:                      /* Vertical scroll area */
+            return 2;
+        case 0x29:                      /* Diagonal scroll */
+        case 0x2A:
+            return 5;
+        case 0x26:                      /* Horizontal scroll */
+        case 0x27:
+            return 6;
+        default:
+            return 0;
+    }
+}
+
+/*  Execute
+ *
+ *      Carry out a complete command
+ */
+
+static void Execute(SSD1306Emu *emu)
+{
+    const uint8_t *c = emu->command;
+    
+    /*
+     *  Single byte commands with a value in the low bits
+     */
+    
+    if (c[0] < 0x10) {                  /* Lower column, page mode */
+        if (emu->memoryMode == SSD1306EMU_PAGE) {
+            emu->pageColumnStart = (emu->pageColumnStart & 0xF0) | c[0];
+            emu->column = emu->pageColumnStart;
+        }
+        return;
+    }
+    if (c[0] < 0x20) {                  /* Upper column, page mode */
+        if (emu->memoryMode == SSD1306EMU_PAGE) {
+            emu->pageColumnStart = (emu->pageColumnStart & 0x0F) | ((c[0] & 0x07) << 4);
+            emu->column = emu->pageColumnStart;
+        }
+        return;
+    }
+    if ((c[0] >= 0x40) && (c[0] < 0x80)) {
+        emu->startLine = c[0] & 0x3F;
+        return;
+    }
+    if ((c[0] >= 0xB0) && (c[0] < 0xB8)) {
+        if (emu->memoryMode == SSD1306EMU_PAGE) {
+            emu->page = c[0] & 0x07;
+        }
+        return;
+    }
+    
+    switch (c[0]) {
+        case 0x20:
+            emu->memoryMode = c[1] & 0x03;
+            if (emu->memoryMode > SSD1306EMU_PAGE) emu->memoryMode = SSD1306EMU_PAGE;
+            break;
+        case 0x21:
+            emu->columnStart = c[1] & 0x7F;
+            emu->columnEnd = c[2] & 0x7F;
+            emu->column = emu->columnStart;
+            break;
+        case 0x22:
+            emu->pageStart = c[1] & 0x07;
+            emu->pageEnd = c[2] & 0x07;
+            emu->page = emu->pageStart;
+            break;
+        case 0x26:
+        case 0x27:
+        case 0x29:
+        case 0x2A:
+            break;                      /* Set up only; 0x2F starts */
+        case 0x2E:
+            emu->scrolling = false;
+            break;
+        case 0x2F:
+            emu->scrolling = true;
+            break;
+        case 0x81:
+            emu->contrast = c[1];
+            break;
+        case 0xA0:
+        case 0xA1:
+            emu->segmentRemap = (c[0] & 1) != 0;
+            break;
+        case 0xA4:
+        case 0xA5:
+            emu->entireOn = (c[0] & 1) != 0;
+            break;
+        case 0xA6:
+        case 0xA7:
+            emu->inverse = (c[0] & 1) != 0;
+            break;
+        case 0xA8:
+            if ((c[1] & 0x3F) >= 15) emu->multiplex = c[1] & 0x3F;
+            break;
+        case 0xAE:
+        case 0xAF:
+            emu->displayOn = (c[0] & 1) != 0;
+            break;
+        case 0xC0:
+            emu->comRemap = false;
+            break;
+        case 0xC8:
+            emu->comRemap = true;
+            break;
+        case 0xD3:
+            emu->offset = c[1] & 0x3F;
+            break;
+        default:
+            break;                      /* Timing and power: no effect here */
+    }
+}
+
+/*  Command
+ *
+ *      Take a command byte, executing the command once its arguments are in
+ */
+
+static void Command(SSD1306Emu *emu, uint8_t b)
+{
+    ++emu->commandBytes;
+    
+    if (emu->commandLength == 0) {
+        emu->commandNeeded = 1 + CommandArguments(b);
+    }
+    emu->command[emu->commandLength++] = b;
+    
+    if (emu->commandLength >= emu->commandNeeded) {
+        Execute(emu);
+        emu->commandLength = 0;
+    }
+}
+
+/*  Data
+ *
+ *      Store a byte of display data and advance the pointers as the current
+ *  addressing mode does
+ */
+
+static void Data(SSD1306Emu *emu, uint8_t b)
+{
+    ++emu->dataBytes;
+    emu->ram[emu->page * SSD1306EMU_WIDTH + emu->column] = b;
+    
+    switch (emu->memoryMode) {
+        case SSD1306EMU_HORIZONTAL:
+            if (emu->column >= emu->columnEnd) {
+                emu->column = emu->columnStart;
+                emu->page = (emu->page >= emu->pageEnd) ? emu->pageStart : emu->page + 1;
+            } else {
+                ++emu->column;
+            }
+            break;
+        case SSD1306EMU_VERTICAL:
+            if (emu->page >= emu->pageEnd) {
+                emu->page = emu->pageStart;
+                emu->column = (emu->column >= emu->columnEnd) ? emu->columnStart : emu->column + 1;
+            } else {
+                ++emu->page;
+            }
+            break;
+        default:
+            emu->column = (emu->column >= SSD1306EMU_WIDTH - 1) ? emu->pageColumnStart : emu->column + 1;
+            break;
+    }
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Transactions															*/
+/*																			*/
+/****************************************************************************/
+
+/*  SSD1306EmuTransaction
+ *
+ *      Decode one I2C write transaction. Transactions for other addresses
+ *  are ignored. Each transaction starts with a control byte: with Co clear
+ *  the rest of the transaction is commands (D/C clear) or data (D/C set);
+ *  with Co set only the next byte is, and another control byte follows.
+ */
+
+void SSD1306EmuTransaction(SSD1306Emu *emu, uint8_t address, const uint8_t *data, uint16_t length)
+{
+    uint16_t i = 0;
+    
+    if (address != emu->address) return;
+    
+    ++emu->transactions;
+    emu->bytes += 1 + length;
+    emu->commandLength = 0;
+    
+    while (i < length) {
+        uint8_t control = data[i++];
+        ++emu->controlBytes;
+        
+        if (control & 0x80) {
+            if (i >= length) break;
+            if (control & 0x40) {
+                Data(emu,data[i++]);
+            } else {
+                Command(emu,data[i++]);
+            }
+        } else {
+            while (i < length) {
+                if (control & 0x40) {
+                    Data(emu,data[i++]);
+                } else {
+                    Command(emu,data[i++]);
+                }
+            }
+        }
+    }
+}
+
+/*  SSD1306EmuHook
+ *
+ *      Transaction hook for twirecord.c. The context is the SSD1306Emu.
+ */
+
+void SSD1306EmuHook(const TWIRecord *record, void *context)
+{
+    if (record->read || (record->data == NULL)) return;
+    SSD1306EmuTransaction((SSD1306Emu *)context,record->address,record->data,record->length);
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Images  																*/
+/*																			*/
+/****************************************************************************/
+
+/*  SSD1306EmuRender
+ *
+ *      Work out what the panel shows. Each screen row is driven by a COM
+ *  line; the display start line is shown on COM[offset], and rows beyond
+ *  the multiplex ratio are dark. The image is drawn as the panel is
+ *  usually mounted, so that with segment remap (0xA1) and COM scan
+ *  decrement (0xC8), as our initialization sets, column 0 is at the left
+ *  and page 0 at the top.
+ */
+
+void SSD1306EmuRender(const SSD1306Emu *emu, uint8_t *pixels)
+{
+    uint8_t level = 64 + (emu->contrast * 191) / 255;
+    uint8_t x,y;
+    
+    for (y = 0; y < SSD1306EMU_HEIGHT; ++y) {
+        uint8_t com = emu->comRemap ? y : (SSD1306EMU_HEIGHT - 1 - y);
+        uint8_t row = (emu->startLine + com - emu->offset) & 0x3F;
+        
+        for (x = 0; x < SSD1306EMU_WIDTH; ++x) {
+            uint8_t seg = emu->segmentRemap ? x : (SSD1306EMU_WIDTH - 1 - x);
+            bool on = (emu->ram[(row / 8) * SSD1306EMU_WIDTH + seg] >> (row % 8)) & 1;
+            
+            if (emu->entireOn) on = true;
+            if (emu->inverse) on = !on;
+            if (!emu->displayOn || (com > emu->multiplex)) on = false;
+            
+            *pixels++ = on ? level : 0;
+        }
+    }
+}
+
+/*  SSD1306EmuWritePBM
+ *
+ *      Write the screen as a binary PBM. PBM uses 1 for black, so lit
+ *  pixels are written as 0 (white) on a black background.
+ */
+
+bool SSD1306EmuWritePBM(const SSD1306Emu *emu, const char *path)
+{
+    uint8_t pixels[SSD1306EMU_WIDTH * SSD1306EMU_HEIGHT];
+    uint8_t line[SSD1306EMU_WIDTH / 8];
+    uint16_t x,y;
+    FILE *f;
+    
+    SSD1306EmuRender(emu,pixels);
+    
+    f = fopen(path,"wb");
+    if (f == NULL) return false;
+    
+    fprintf(f,"P4\n%d %d\n",SSD1306EMU_WIDTH,SSD1306EMU_HEIGHT);
+    for (y = 0; y < SSD1306EMU_HEIGHT; ++y) {
+        memset(line,0,sizeof(line));
+        for (x = 0; x < SSD1306EMU_WIDTH; ++x) {
+            if (!pixels[y * SSD1306EMU_WIDTH + x]) line[x / 8] |= 0x80 >> (x % 8);
+        }
+        fwrite(line,1,sizeof(line),f);
+    }
+    
+    return fclose(f) == 0;
+}
+
+/*  PNG support
+ *
+ *      An 8 bit grayscale PNG, with the image data in a single stored
+ *  (uncompressed) deflate block, so no compression library is needed.
+ */
+
+static uint32_t PNGCRC(uint32_t crc, const uint8_t *data, uint32_t length)
+{
+    uint32_t i;
+    uint8_t k;
+    
+    crc = ~crc;
+    for (i = 0; i < length; ++i) {
+        crc ^= data[i];
+        for (k = 0; k < 8; ++k) {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static void PNGPut32(uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = (uint8_t)(value >> 24);
+    buffer[1] = (uint8_t)(value >> 16);
+    buffer[2] = (uint8_t)(value >> 8);
+    buffer[3] = (uint8_t)value;
+}
+
+static void PNGChunk(FILE *f, const char *type, const uint8_t *data, uint32_t length)
+{
+    uint8_t header[8];
+    uint8_t trailer[4];
+    uint32_t crc;
+    
+    PNGPut32(header,length);
+    memcpy(header + 4,type,4);
+    crc = PNGCRC(0,header + 4,4);
+    crc = PNGCRC(crc,data,length);
+    PNGPut32(trailer,crc);
+    
+    fwrite(header,1,8,f);
+    fwrite(data,1,length,f);
+    fwrite(trailer,1,4,f);
+}
+
+/*  SSD1306EmuWritePNG
+ *
+ *      Write the screen as a grayscale PNG
+ */
+
+bool SSD1306EmuWritePNG(const SSD1306Emu *emu, const char *path)
+{
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    
+    enum {
+        RAWSIZE = SSD1306EMU_HEIGHT * (1 + SSD1306EMU_WIDTH),    /* Filter byte per row */
+        ZSIZE = 2 + 5 + RAWSIZE + 4                             /* Header, block, Adler */
+    };
+    
+    uint8_t pixels[SSD1306EMU_WIDTH * SSD1306EMU_HEIGHT];
+    uint8_t ihdr[13];
+    uint8_t z[ZSIZE];
+    uint8_t *raw = z + 7;
+    uint32_t a = 1, b = 0;
+    uint16_t i,y;
+    FILE *f;
+    
+    SSD1306EmuRender(emu,pixels);
+    
+    PNGPut32(ihdr,SSD1306EMU_WIDTH);
+    PNGPut32(ihdr + 4,SSD1306EMU_HEIGHT);
+    ihdr[8] = 8;                        /* Bit depth */
+    ihdr[9] = 0;                        /* Grayscale */
+    ihdr[10] = 0;                       /* Deflate */
+    ihdr[11] = 0;                       /* Adaptive filtering */
+    ihdr[12] = 0;                       /* Not interlaced */
+    
+    z[0] = 0x78;                        /* zlib header: deflate, 32K window */
+    z[1] = 0x01;
+    z[2] = 0x01;                        /* Final block, stored */
+    z[3] = RAWSIZE & 0xFF;
+    z[4] = RAWSIZE >> 8;
+    z[5] = ~RAWSIZE & 0xFF;
+    z[6] = (~RAWSIZE >> 8) & 0xFF;
+    
+    for (y = 0; y < SSD1306EMU_HEIGHT; ++y) {
+        raw[y * (1 + SSD1306EMU_WIDTH)] = 0;   /* No filter */
+        memcpy(raw + y * (1 + SSD1306EMU_WIDTH) + 1,pixels + y * SSD1306EMU_WIDTH,SSD1306EMU_WIDTH);
+    }
+    for (i = 0; i < RAWSIZE; ++i) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    PNGPut32(z + 7 + RAWSIZE,(b << 16) | a);
+    
+    f = fopen(path,"wb");
+    if (f == NULL) return false;
+    
+    fwrite(signature,1,sizeof(signature),f);
+    PNGChunk(f,"IHDR",ihdr,sizeof(ihdr));
+    PNGChunk(f,"IDAT",z,sizeof(z));
+    PNGChunk(f,"IEND",NULL,0);
+    
+    return fclose(f) == 0;
+}
@@ -0,0 +1,131 @@
+/*  ssd1306emu.h
+ *
+ *      Host emulation of the SSD1306 controller. Transactions sent to the
+ *  display's address are decoded, control bytes (including the Co bit),
+ *  commands and data, into a 1K GDDRAM, following the memory addressing
+ *  mode, column and page addresses, start line, display offset, segment and
+ *  COM remap, multiplex ratio, contrast, inverse and display on/off
+ *  settings. The emulated screen can be written out as a PBM or PNG image.
+ *  The emulator also counts transactions and bytes, so flush efficiency can
+ *  be measured off target.
+ *
+ *      Scrolling commands are decoded but the scroll itself is not animated.
+ *
+ *      The emulator plugs in behind twirecord.c, which stands in for the I2C
+ *  driver: pass SSD1306EmuHook to TWIRecordSetHook. For example, from this
+ *  directory:
+ *
+ *      g++ -I. -I.. -o test test.cpp ssd1306emu.c twirecord.c \
+ *          ../ssd1306.cpp ../display.cpp
+ *
+ *  where test.cpp sets up
+ *
+ *      SSD1306Emu emu;
+ *      SSD1306EmuInit(&emu,SSD1306_I2C_ADDRESS);
+ *      TWIRecordSetHook(SSD1306EmuHook,&emu);
+ *
+ *  before drawing, and calls SSD1306EmuWritePNG(&emu,"frame.png") to save
+ *  what the panel shows.
+ */
+
+#ifndef _SSD1306EMU_H
+#define _SSD1306EMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "twirecord.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************/
+/*																			*/
+/*	Constants																*/
+/*																			*/
+/****************************************************************************/
+
+#define SSD1306EMU_WIDTH        128
+#define SSD1306EMU_HEIGHT       64
+#define SSD1306EMU_PAGES        8
+
+/*
+ *  Memory addressing modes (command 0x20)
+ */
+
+#define SSD1306EMU_HORIZONTAL   0
+#define SSD1306EMU_VERTICAL     1
+#define SSD1306EMU_PAGE         2
+
+/****************************************************************************/
+/*																			*/
+/*	Emulator State															*/
+/*																			*/
+/****************************************************************************/
+
+/*  SSD1306Emu
+ *
+ *      The controller's memory and registers, and transfer counters
+ */
+
+typedef struct SSD1306Emu {
+    uint8_t address;                    /* 7 bit I2C address */
+    uint8_t ram[SSD1306EMU_PAGES * SSD1306EMU_WIDTH];
+
+    /* Addressing */
+    uint8_t memoryMode;                 /* SSD1306EMU_xxx */
+    uint8_t column;                     /* Current pointers */
+    uint8_t page;
+    uint8_t columnStart,columnEnd;      /* Window, horizontal/vertical */
+    uint8_t pageStart,pageEnd;
+    uint8_t pageColumnStart;            /* Column start, page mode */
+
+    /* Display */
+    uint8_t startLine;
+    uint8_t offset;
+    uint8_t multiplex;                  /* Rows - 1 */
+    uint8_t contrast;
+    bool segmentRemap;                  /* 0xA1 */
+    bool comRemap;                      /* 0xC8 */
+    bool inverse;                       /* 0xA7 */
+    bool entireOn;                      /* 0xA5 */
+    bool displayOn;                     /* 0xAF */
+    bool scrolling;
+
+    /* Command being assembled */
+    uint8_t command[8];
+    uint8_t commandLength;
+    uint8_t commandNeeded;
+
+    /* Counters */
+    uint32_t transactions;              /* Addressed to us */
+    uint32_t bytes;                     /* Including address bytes */
+    uint32_t controlBytes;
+    uint32_t commandBytes;
+    uint32_t dataBytes;
+} SSD1306Emu;
+
+/****************************************************************************/
+/*																			*/
+/*	Routines																*/
+/*																			*/
+/****************************************************************************/
+
+extern void SSD1306EmuInit(SSD1306Emu *emu, uint8_t address);
+extern void SSD1306EmuClearCounters(SSD1306Emu *emu);
+
+extern void SSD1306EmuTransaction(SSD1306Emu *emu, uint8_t address, const uint8_t *data, uint16_t length);
+extern void SSD1306EmuHook(const TWIRecord *record, void *context);
+
+/* Screen as shown, one byte per pixel from the top left: 0 for off, or
+ * a level from 64 to 255 set by the contrast */
+extern void SSD1306EmuRender(const SSD1306Emu *emu, uint8_t *pixels);
+
+extern bool SSD1306EmuWritePBM(const SSD1306Emu *emu, const char *path);
+extern bool SSD1306EmuWritePNG(const SSD1306Emu *emu, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SSD1306EMU_H */
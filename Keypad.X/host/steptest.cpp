@@ -0,0 +1,258 @@
+/*  steptest.cpp
+ *
+ *      Host test for incremental flushing. Random drawing is interleaved
+ *  with writeDisplayStep calls of random sizes and writeDisplayFor calls
+ *  with random deadlines, at several bus speeds, with and without diff mode
+ *  and priority areas. The clock advances as the bus would, by the time
+ *  PlanTime gives for each transaction. We check each step keeps to its
+ *  budget, writeDisplayFor does not run far past its deadline, and once the
+ *  dirty regions drain the emulated device matches display memory. From
+ *  this directory:
+ *
+ *      g++ -I. -I.. -o steptest steptest.cpp ssd1306emu.c twirecord.c \
+ *          ../ssd1306.cpp ../display.cpp
+ *      ./steptest
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssd1306.h"
+#include "ssd1306emu.h"
+#include "timers.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Constants																*/
+/*																			*/
+/****************************************************************************/
+
+#define WIDTH           128
+#define HEIGHT          64
+#define ROUNDS          400
+#define STEPS           12
+
+/*
+ *  A step always sends at least one page, which may take it over budget.
+ *  One page of a region is at most a full width page plus its commands.
+ */
+
+#define PAGEBYTES       (WIDTH + 32)
+
+/****************************************************************************/
+/*																			*/
+/*	Simulated Clock															*/
+/*																			*/
+/****************************************************************************/
+
+static uint64_t Micros;
+
+uint32_t GetMilliseconds(void)
+{
+    return (uint32_t)(Micros / 1000);
+}
+
+void DelayMilliseconds(uint16_t ms)
+{
+    Micros += ms * 1000ULL;
+}
+
+/*  BusMicros
+ *
+ *      The time PlanTime allows for a transaction of the given length,
+ *  including its address byte
+ */
+
+static uint32_t BusMicros(uint32_t bytes, uint32_t transactions)
+{
+    uint32_t bits = bytes * 9 + transactions * 2;
+    return (bits * 1000) / (TWIGetFrequency() / 1000) + transactions * SSD1306_TXNTIME;
+}
+
+/*  Hook
+ *
+ *      Pass each transaction to the emulator and advance the clock
+ */
+
+static void Hook(const TWIRecord *record, void *context)
+{
+    SSD1306EmuHook(record,context);
+    Micros += BusMicros(record->length + 1,1);
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Test Support															*/
+/*																			*/
+/****************************************************************************/
+
+class Test: public SSD1306
+{
+    public:
+        const uint8_t *memory()
+                        {
+                            return display;
+                        }
+};
+
+static Test Display;
+static SSD1306Emu Emu;
+static uint32_t Failures;
+
+static void Fail(const char *label, const char *what, uint32_t a, uint32_t b)
+{
+    if (++Failures <= 10) printf("FAIL %s: %s %u, %u\n",label,what,a,b);
+}
+
+/*  RandomDrawing
+ *
+ *      Draw a few random rectangles, mostly small
+ */
+
+static void RandomDrawing(void)
+{
+    uint8_t n = 1 + rand() % 4;
+
+    for (uint8_t i = 0; i < n; ++i) {
+        GDRect r;
+        uint8_t big = (rand() % 6 == 0) ? 6 : 1;
+
+        r.origin.x = rand() % WIDTH;
+        r.origin.y = rand() % HEIGHT;
+        r.size.width = 1 + rand() % (16 * big);
+        r.size.height = 1 + rand() % (8 * big);
+
+        Display.setDrawingMode((rand() % 3 == 0) ? GL_WHITE : GL_XOR);
+        Display.paintRect(r);
+    }
+}
+
+/*  RandomAreas
+ *
+ *      Replace the priority areas with up to two random ones
+ */
+
+static void RandomAreas(void)
+{
+    uint8_t n = rand() % 3;
+
+    Display.clearPriorities();
+    for (uint8_t i = 0; i < n; ++i) {
+        GDRect r;
+
+        r.origin.x = rand() % WIDTH;
+        r.origin.y = rand() % HEIGHT;
+        r.size.width = 1 + rand() % (WIDTH - r.origin.x);
+        r.size.height = 1 + rand() % (HEIGHT - r.origin.y);
+        Display.setPriority(r,(rand() % 2) ? SSD1306_PRIORITY_HIGH : SSD1306_PRIORITY_LOW);
+    }
+}
+
+/*  Step
+ *
+ *      Send one step of a random size, checking it kept to its budget and
+ *  its plan matches what was sent
+ */
+
+static void Step(const char *label)
+{
+    uint16_t maxBytes = 1 + rand() % 600;
+    uint32_t bytes = TWIRecordBytes();
+
+    Display.writeDisplayStep(maxBytes);
+    bytes = TWIRecordBytes() - bytes;
+
+    if ((bytes > maxBytes) && (bytes > PAGEBYTES)) Fail(label,"step over budget",bytes,maxBytes);
+    if (Display.lastPlan().bytes != bytes) Fail(label,"step plan bytes",Display.lastPlan().bytes,bytes);
+}
+
+/*  StepFor
+ *
+ *      Send until a random deadline, checking we don't run past it. The
+ *  last step was sized from the whole milliseconds left when it started, so
+ *  it may overrun by the part millisecond already gone then. It may also
+ *  overrun if it could only send its one page.
+ */
+
+static void StepFor(const char *label)
+{
+    uint32_t deadline = GetMilliseconds() + 1 + rand() % 40;
+    uint32_t bytes = TWIRecordBytes();
+
+    Display.writeDisplayFor(deadline);
+    if (TWIRecordBytes() == bytes) return;
+
+    const SSD1306Plan &last = Display.lastPlan();
+    uint64_t start = Micros - last.micros;
+    uint64_t limit = deadline * 1000ULL + start % 1000;
+
+    if ((Micros > limit) && (last.bytes > PAGEBYTES)) {
+        Fail(label,"past deadline (us), step bytes",(uint32_t)(Micros - deadline * 1000ULL),last.bytes);
+    }
+}
+
+/*  Drain
+ *
+ *      Step until nothing is dirty, then check the device
+ */
+
+static void Drain(const char *label)
+{
+    for (uint16_t i = 0; (i < 1000) && (Display.dirtyRegionCount() > 0); ++i) {
+        Step(label);
+    }
+
+    if (Display.dirtyRegionCount() > 0) Fail(label,"regions left",Display.dirtyRegionCount(),0);
+    if (memcmp(Emu.ram,Display.memory(),sizeof(Emu.ram))) Fail(label,"device differs",0,0);
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Tests																	*/
+/*																			*/
+/****************************************************************************/
+
+int main()
+{
+    static const uint32_t freq[] = { TWI_FREQ, TWI_FREQ_FAST, TWI_FREQ_FASTPLUS };
+    char label[32];
+
+    SSD1306EmuInit(&Emu,SSD1306_I2C_ADDRESS);
+    TWIRecordSetHook(Hook,&Emu);
+
+    srand(1);
+    for (uint8_t f = 0; f < 3; ++f) {
+        for (uint8_t diff = 0; diff < 2; ++diff) {
+            TWIInit(freq[f]);
+            Display.start();
+            Display.setDiffMode(diff);
+            Display.writeDisplay();
+
+            sprintf(label,"%uk %s",(unsigned)(freq[f] / 1000),diff ? "diff" : "windows");
+            for (uint32_t i = 0; i < ROUNDS; ++i) {
+                if (i % 50 == 0) RandomAreas();
+
+                for (uint8_t s = 0; s < STEPS; ++s) {
+                    RandomDrawing();
+                    switch (rand() % 4) {
+                        case 0:
+                            StepFor(label);
+                            break;
+                        case 1:
+                            if (rand() % 8 == 0) Display.writeDisplay();
+                            break;
+                        default:
+                            Step(label);
+                            break;
+                    }
+                }
+                Drain(label);
+            }
+        }
+    }
+    Display.clearPriorities();
+
+    printf("%s: %u failures\n",Failures ? "FAIL" : "PASS",Failures);
+    return Failures ? 1 : 0;
+}
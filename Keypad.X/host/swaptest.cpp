@@ -0,0 +1,208 @@
+/*  swaptest.cpp
+ *
+ *      Host test for the SSD1306 double buffered asynchronous flush. Random
+ *  frames are drawn and sent with swap, with and without diff mode and
+ *  priority areas. With the driver stand-in completing transfers at once,
+ *  the device must match display memory after each swap. With transfers
+ *  deferred, drawing carries on while the flush runs a transfer at a time:
+ *  swap must refuse to start another flush until it is done, and the device
+ *  must end up holding the frame as it was when the flush started. From
+ *  this directory:
+ *
+ *      g++ -I. -I.. -o swaptest swaptest.cpp ssd1306emu.c twirecord.c \
+ *          ../ssd1306.cpp ../display.cpp
+ *      ./swaptest
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssd1306.h"
+#include "ssd1306emu.h"
+#include "timers.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Constants																*/
+/*																			*/
+/****************************************************************************/
+
+#define WIDTH           128
+#define HEIGHT          64
+#define MEMORY          (WIDTH * HEIGHT / 8)
+#define FRAMES          2000
+
+/****************************************************************************/
+/*																			*/
+/*	Timer Stand-ins															*/
+/*																			*/
+/****************************************************************************/
+
+uint32_t GetMilliseconds(void)
+{
+    return 0;
+}
+
+void DelayMilliseconds(uint16_t)
+{
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Test Support															*/
+/*																			*/
+/****************************************************************************/
+
+class Test: public SSD1306
+{
+    public:
+        const uint8_t *memory()
+                        {
+                            return display;
+                        }
+};
+
+static Test Display;
+static SSD1306Emu Emu;
+static uint32_t Failures;
+
+static void Fail(const char *label, const char *what)
+{
+    if (++Failures <= 10) printf("FAIL %s: %s\n",label,what);
+}
+
+/*  RandomFrame
+ *
+ *      Draw a few random rectangles, mostly small
+ */
+
+static void RandomFrame(void)
+{
+    uint8_t n = 1 + rand() % 5;
+
+    for (uint8_t i = 0; i < n; ++i) {
+        GDRect r;
+        uint8_t big = (rand() % 8 == 0) ? 6 : 1;
+
+        r.origin.x = rand() % WIDTH;
+        r.origin.y = rand() % HEIGHT;
+        r.size.width = 1 + rand() % (16 * big);
+        r.size.height = 1 + rand() % (8 * big);
+
+        Display.setDrawingMode((rand() % 3 == 0) ? GL_WHITE : GL_XOR);
+        Display.paintRect(r);
+    }
+}
+
+/*  RandomAreas
+ *
+ *      Replace the priority areas with up to two random ones
+ */
+
+static void RandomAreas(void)
+{
+    uint8_t n = rand() % 3;
+
+    Display.clearPriorities();
+    for (uint8_t i = 0; i < n; ++i) {
+        GDRect r;
+
+        r.origin.x = rand() % WIDTH;
+        r.origin.y = rand() % HEIGHT;
+        r.size.width = 1 + rand() % (WIDTH - r.origin.x);
+        r.size.height = 1 + rand() % (HEIGHT - r.origin.y);
+        Display.setPriority(r,(rand() % 2) ? SSD1306_PRIORITY_HIGH : SSD1306_PRIORITY_LOW);
+    }
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Tests																	*/
+/*																			*/
+/****************************************************************************/
+
+/*  TestImmediate
+ *
+ *      Each swap's transfers complete before it returns
+ */
+
+static void TestImmediate(const char *label)
+{
+    for (uint32_t i = 0; i < FRAMES; ++i) {
+        if (i % 200 == 0) RandomAreas();
+        RandomFrame();
+
+        if (!Display.swap()) Fail(label,"swap refused");
+        if (Display.isFlushing()) Fail(label,"still flushing");
+        if (Display.dirtyRegionCount() != 0) Fail(label,"regions left");
+        if (memcmp(Emu.ram,Display.memory(),MEMORY)) Fail(label,"device differs");
+    }
+}
+
+/*  TestDeferred
+ *
+ *      Each swap's transfers complete one at a time, with drawing between
+ */
+
+static void TestDeferred(const char *label)
+{
+    uint8_t frame[MEMORY];
+
+    TWIRecordSetDeferred(true);
+    for (uint32_t i = 0; i < FRAMES; ++i) {
+        if (i % 200 == 0) RandomAreas();
+        RandomFrame();
+
+        memcpy(frame,Display.memory(),MEMORY);
+        if (!Display.swap()) Fail(label,"swap refused while idle");
+
+        /*
+         *  Draw while the flush runs. Another swap must be refused and
+         *  leave the new drawing dirty.
+         */
+
+        while (Display.isFlushing()) {
+            RandomFrame();
+            if (Display.swap()) Fail(label,"swap accepted while flushing");
+            if (Display.dirtyRegionCount() == 0) Fail(label,"drawing lost");
+            TWIService();
+        }
+        if (TWIRecordPending() != 0) Fail(label,"transfers left");
+        if (memcmp(Emu.ram,frame,MEMORY)) Fail(label,"device differs from swapped frame");
+    }
+
+    /*
+     *  Send what was drawn during the last flush
+     */
+
+    if (!Display.swap()) Fail(label,"final swap refused");
+    TWIWaitIdle();
+    if (Display.isFlushing()) Fail(label,"still flushing");
+    if (memcmp(Emu.ram,Display.memory(),MEMORY)) Fail(label,"device differs");
+    TWIRecordSetDeferred(false);
+}
+
+int main()
+{
+    char label[32];
+
+    SSD1306EmuInit(&Emu,SSD1306_I2C_ADDRESS);
+    TWIRecordSetHook(SSD1306EmuHook,&Emu);
+    Display.start();
+
+    srand(1);
+    for (uint8_t diff = 0; diff < 2; ++diff) {
+        Display.setDiffMode(diff);
+        Display.writeDisplay();
+
+        sprintf(label,"immediate %s",diff ? "diff" : "windows");
+        TestImmediate(label);
+        sprintf(label,"deferred %s",diff ? "diff" : "windows");
+        TestDeferred(label);
+    }
+    Display.clearPriorities();
+
+    printf("%s: %u failures\n",Failures ? "FAIL" : "PASS",Failures);
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,12 @@
+/*  attribs.h
+ *
+ *      Host stand-in for the XC32 attribute header. Interrupt handlers become
+ *  ordinary functions, which the simulator calls.
+ */
+
+#ifndef _HOST_SYS_ATTRIBS_H
+#define _HOST_SYS_ATTRIBS_H
+
+#define __ISR(vector, ipl)
+
+#endif /* _HOST_SYS_ATTRIBS_H */
@@ -0,0 +1,341 @@
+/*  twirecord.c
+ *
+ *      Host stand-in for the I2C driver which records transactions
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "i2c.h"
+#include "twirecord.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Globals 																*/
+/*																			*/
+/****************************************************************************/
+
+static TWIRecord RecordList[TWIRECORD_MAXRECORDS];
+static uint8_t RecordData[TWIRECORD_MAXDATA];
+static uint32_t RecordDataUsed;
+static uint8_t RecordScratch[65536];    /* Hook copy once the pool is full */
+static uint32_t RecordCount;
+static uint32_t RecordBytes;
+
+static TWIRecordHook RecordHook;
+static void *RecordHookContext;
+
+static uint32_t RecordFrequency = TWI_FREQ;
+static TWIStats RecordStats;
+
+/*
+ *  Deferred transfers, oldest first
+ */
+
+typedef struct Pending {
+    uint8_t addr;
+    uint8_t flags;
+    TWISegment segments[TWIRECORD_MAXSEGMENTS];
+    uint8_t count;
+    TWICallback callback;
+    void *context;
+} Pending;
+
+static bool Deferred;
+static Pending PendingList[TWI_QUEUESIZE];
+static uint8_t PendingHead;
+static uint8_t PendingCount;
+
+/****************************************************************************/
+/*																			*/
+/*	Recording																*/
+/*																			*/
+/****************************************************************************/
+
+/*  TWIRecordClear
+ *
+ *      Forget all recorded transactions
+ */
+
+void TWIRecordClear(void)
+{
+    RecordDataUsed = 0;
+    RecordCount = 0;
+    RecordBytes = 0;
+}
+
+/*  TWIRecordSetHook
+ *
+ *      Set a routine to be called with each transaction as it is recorded, or
+ *  NULL for none
+ */
+
+void TWIRecordSetHook(TWIRecordHook hook, void *context)
+{
+    RecordHook = hook;
+    RecordHookContext = context;
+}
+
+uint32_t TWIRecordCount(void)
+{
+    return RecordCount;
+}
+
+uint32_t TWIRecordBytes(void)
+{
+    return RecordBytes;
+}
+
+/*  TWIRecordGet
+ *
+ *      Return the given transaction, or NULL if it was not kept
+ */
+
+const TWIRecord *TWIRecordGet(uint32_t index)
+{
+    if ((index >= RecordCount) || (index >= TWIRECORD_MAXRECORDS)) return NULL;
+    return RecordList + index;
+}
+
+/*  Record
+ *
+ *      Record a transaction made of the given segments
+ */
+
+static void Record(uint8_t addr, bool read, bool stop, const TWISegment *segments, uint8_t count)
+{
+    TWIRecord rec;
+    uint32_t length = 0;
+    uint8_t *d;
+    bool kept;
+    uint8_t i;
+    
+    for (i = 0; i < count; ++i) length += segments[i].length;
+    
+    rec.address = addr;
+    rec.read = read;
+    rec.stop = stop;
+    rec.length = (uint16_t)length;
+    
+    /*
+     *  Gather the data into the pool if there is room, or else into scratch
+     *  space so the hook still sees it
+     */
+    
+    if (RecordDataUsed + length <= TWIRECORD_MAXDATA) {
+        d = RecordData + RecordDataUsed;
+        RecordDataUsed += length;
+        kept = true;
+    } else {
+        d = RecordScratch;
+        kept = false;
+    }
+    rec.data = d;
+    for (i = 0; i < count; ++i) {
+        memcpy(d,segments[i].data,segments[i].length);
+        d += segments[i].length;
+    }
+    
+    if (RecordCount < TWIRECORD_MAXRECORDS) {
+        RecordList[RecordCount] = rec;
+        if (!kept) RecordList[RecordCount].data = NULL;
+    }
+    ++RecordCount;
+    RecordBytes += 1 + length;
+    
+    if (RecordHook) RecordHook(&rec,RecordHookContext);
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Deferred Transfers														*/
+/*																			*/
+/****************************************************************************/
+
+/*  TWIRecordSetDeferred
+ *
+ *      Queue asynchronous transfers until TWIService rather than completing
+ *  them at once
+ */
+
+void TWIRecordSetDeferred(bool deferred)
+{
+    TWIWaitIdle();
+    Deferred = deferred;
+}
+
+uint8_t TWIRecordPending(void)
+{
+    return PendingCount;
+}
+
+/*  Defer
+ *
+ *      Queue an asynchronous transfer, or complete it now if we are not
+ *  deferring
+ */
+
+static int8_t Defer(uint8_t addr, const TWISegment *segments, uint8_t count, uint8_t flags, TWICallback callback, void *context)
+{
+    Pending *p;
+    
+    if (!Deferred) {
+        bool stop = (flags & TWI_FLAG_STOP) != 0;
+        int8_t status;
+        
+        if (flags & TWI_FLAG_READ) {
+            status = TWIRead(addr,(uint8_t *)segments[0].data,segments[0].length,stop);
+        } else {
+            status = TWIWritev(addr,segments,count,stop);
+        }
+        if (callback) callback(status,context);
+        return TWI_SUCCESS;
+    }
+    
+    if ((PendingCount >= TWI_QUEUESIZE) || (count > TWIRECORD_MAXSEGMENTS)) return TWI_ERROR_QUEUE_FULL;
+    
+    p = PendingList + (PendingHead + PendingCount++) % TWI_QUEUESIZE;
+    p->addr = addr;
+    p->flags = flags;
+    memcpy(p->segments,segments,count * sizeof(TWISegment));
+    p->count = count;
+    p->callback = callback;
+    p->context = context;
+    return TWI_SUCCESS;
+}
+
+/*  Complete
+ *
+ *      Complete the oldest deferred transfer. The callback may queue more.
+ */
+
+static void Complete(void)
+{
+    Pending p = PendingList[PendingHead];
+    
+    PendingHead = (PendingHead + 1) % TWI_QUEUESIZE;
+    --PendingCount;
+    
+    if (p.flags & TWI_FLAG_READ) {
+        memset((uint8_t *)p.segments[0].data,0,p.segments[0].length);
+    }
+    Record(p.addr,(p.flags & TWI_FLAG_READ) != 0,(p.flags & TWI_FLAG_STOP) != 0,p.segments,p.count);
+    if (p.callback) p.callback(TWI_SUCCESS,p.context);
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Driver Stand-in															*/
+/*																			*/
+/****************************************************************************/
+
+void TWIInit(uint32_t frequency)
+{
+    RecordFrequency = frequency;
+}
+
+void TWIShutdown(void)
+{
+}
+
+void TWIService(void)
+{
+    if (PendingCount > 0) Complete();
+}
+
+bool TWIWaitIdle(void)
+{
+    while (PendingCount > 0) Complete();
+    return true;
+}
+
+void TWIGetStats(TWIStats *stats)
+{
+    *stats = RecordStats;
+}
+
+void TWIClearStats(void)
+{
+    memset(&RecordStats,0,sizeof(RecordStats));
+}
+
+uint32_t TWISetFrequency(uint32_t frequency)
+{
+    RecordFrequency = frequency;
+    return frequency;
+}
+
+uint32_t TWIGetFrequency(void)
+{
+    return RecordFrequency;
+}
+
+void TWISetAdaptive(bool adaptive)
+{
+    (void)adaptive;
+}
+
+int8_t TWIWrite(uint8_t addr, const uint8_t *data, uint16_t len, bool stop)
+{
+    TWISegment seg = { data, len };
+    
+    TWIWaitIdle();
+    Record(addr,false,stop,&seg,1);
+    return TWI_SUCCESS;
+}
+
+int8_t TWIRead(uint8_t addr, uint8_t *data, uint16_t len, bool stop)
+{
+    TWISegment seg = { data, len };
+    
+    TWIWaitIdle();
+    memset(data,0,len);
+    Record(addr,true,stop,&seg,1);
+    return TWI_SUCCESS;
+}
+
+int8_t TWIWritev(uint8_t addr, const TWISegment *segments, uint8_t count, bool stop)
+{
+    TWIWaitIdle();
+    Record(addr,false,stop,segments,count);
+    return TWI_SUCCESS;
+}
+
+int8_t TWIEnqueue(uint8_t addr, uint8_t *data, uint16_t len, uint8_t flags, TWICallback callback, void *context)
+{
+    TWISegment seg = { data, len };
+    
+    return Defer(addr,&seg,1,flags,callback,context);
+}
+
+int8_t TWIEnqueuev(uint8_t addr, const TWISegment *segments, uint8_t count, uint8_t flags, TWICallback callback, void *context)
+{
+    return Defer(addr,segments,count,flags & ~TWI_FLAG_READ,callback,context);
+}
+
+int8_t TWIWriteAsync(uint8_t addr, const uint8_t *data, uint16_t len, bool stop, TWICallback callback, void *context)
+{
+    TWISegment seg = { data, len };
+    
+    return Defer(addr,&seg,1,stop ? TWI_FLAG_STOP : 0,callback,context);
+}
+
+int8_t TWIReadAsync(uint8_t addr, uint8_t *data, uint16_t len, bool stop, TWICallback callback, void *context)
+{
+    TWISegment seg = { data, len };
+    
+    return Defer(addr,&seg,1,(stop ? TWI_FLAG_STOP : 0) | TWI_FLAG_READ,callback,context);
+}
+
+void TWIStatusCallback(int8_t status, void *context)
+{
+    TWIStatus *s = (TWIStatus *)context;
+    
+    s->status = status;
+    s->done = true;
+}
+
+bool TWIIsBusy(void)
+{
+    return PendingCount > 0;
+}
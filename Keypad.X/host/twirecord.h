@@ -0,0 +1,87 @@
+/*  twirecord.h
+ *
+ *      Host stand-in for the I2C driver (i2c.c) which records transactions
+ *  instead of sending them, so code that talks to the display can be run and
+ *  checked on a desktop machine. Every write succeeds at once; asynchronous
+ *  calls complete (and call back) before they return, unless deferred with
+ *  TWIRecordSetDeferred. Reads return zeros.
+ *
+ *      The stand-in reports the frequency passed to TWIInit or
+ *  TWISetFrequency as the bus frequency. The code under test will usually
+ *  need DelayMilliseconds and GetMilliseconds, which the test program
+ *  supplies. For example, from this directory:
+ *
+ *      g++ -I. -I.. -o plantest plantest.cpp ssd1306emu.c twirecord.c \
+ *          ../ssd1306.cpp ../display.cpp
+ */
+
+#ifndef _TWIRECORD_H
+#define _TWIRECORD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************/
+/*																			*/
+/*	Records 																*/
+/*																			*/
+/****************************************************************************/
+
+/*  TWIRecord
+ *
+ *      One recorded transaction. The first TWIRECORD_MAXRECORDS transactions
+ *  are kept, with their data while there is room for it (after that data is
+ *  NULL); later transactions are only counted.
+ */
+
+typedef struct TWIRecord {
+    uint8_t address;
+    bool read;
+    bool stop;
+    uint16_t length;
+    const uint8_t *data;
+} TWIRecord;
+
+#define TWIRECORD_MAXRECORDS    4096
+#define TWIRECORD_MAXDATA       65536
+#define TWIRECORD_MAXSEGMENTS   16          /* Per deferred transfer */
+
+/*
+ *  Called with each transaction as it is recorded, if set. The hook is
+ *  always given the data, even once the record itself no longer keeps it.
+ */
+
+typedef void (*TWIRecordHook)(const TWIRecord *record, void *context);
+
+/****************************************************************************/
+/*																			*/
+/*	Routines																*/
+/*																			*/
+/****************************************************************************/
+
+extern void TWIRecordClear(void);
+extern void TWIRecordSetHook(TWIRecordHook hook, void *context);
+
+/*
+ *  When deferred, asynchronous transfers are queued (up to TWI_QUEUESIZE)
+ *  and each TWIService call completes the next one, recording it and calling
+ *  back as the interrupt would. Synchronous calls and TWIWaitIdle first
+ *  complete everything queued. Off by default.
+ */
+
+extern void TWIRecordSetDeferred(bool deferred);
+extern uint8_t TWIRecordPending(void);          /* Deferred transfers queued */
+
+extern uint32_t TWIRecordCount(void);           /* Transactions */
+extern uint32_t TWIRecordBytes(void);           /* Bytes, with address bytes */
+extern const TWIRecord *TWIRecordGet(uint32_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TWIRECORD_H */
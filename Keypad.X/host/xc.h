@@ -0,0 +1,189 @@
+/*  xc.h
+ *
+ *      Host stand-in for the XC32 device header, so the I2C driver (i2c.c)
+ *  can be compiled and run on a desktop machine. Only the registers the
+ *  driver uses are declared. Each register is a plain variable, with the
+ *  bit field view laid over it as on the real part; i2csim.c defines the
+ *  variables and plays the part of the I2C peripheral.
+ *
+ *      Add this directory to the include path ahead of the compiler's own
+ *  headers: see i2csim.h.
+ */
+
+#ifndef _HOST_XC_H
+#define _HOST_XC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************/
+/*																			*/
+/*	I2C 1																	*/
+/*																			*/
+/****************************************************************************/
+
+typedef struct {
+    unsigned SEN:1;
+    unsigned RSEN:1;
+    unsigned PEN:1;
+    unsigned RCEN:1;
+    unsigned ACKEN:1;
+    unsigned ACKDT:1;
+    unsigned STREN:1;
+    unsigned GCEN:1;
+    unsigned SMEN:1;
+    unsigned DISSLW:1;
+    unsigned A10M:1;
+    unsigned STRICT:1;
+    unsigned SCLREL:1;
+    unsigned SIDL:1;
+    unsigned :1;
+    unsigned ON:1;
+} __I2C1CONbits_t;
+
+typedef struct {
+    unsigned TBF:1;
+    unsigned RBF:1;
+    unsigned R_W:1;
+    unsigned S:1;
+    unsigned P:1;
+    unsigned D_A:1;
+    unsigned I2COV:1;
+    unsigned IWCOL:1;
+    unsigned ADD10:1;
+    unsigned GCSTAT:1;
+    unsigned BCL:1;
+    unsigned :3;
+    unsigned TRSTAT:1;
+    unsigned ACKSTAT:1;
+} __I2C1STATbits_t;
+
+extern volatile uint32_t I2C1CON;
+extern volatile uint32_t I2C1STAT;
+extern volatile uint32_t I2C1BRG;
+extern volatile uint32_t I2C1TRN;
+extern volatile uint32_t I2C1RCV;
+
+/*
+ *  Bit field access to I2C1CON goes through i2csim.c, so the simulator sees
+ *  the module being turned off even when the driver turns it back on before
+ *  the next step (see I2CSimControl)
+ */
+
+extern volatile uint32_t *I2CSimControl(void);
+
+#define I2C1CONbits         (*(volatile __I2C1CONbits_t *)I2CSimControl())
+#define I2C1STATbits        (*(volatile __I2C1STATbits_t *)&I2C1STAT)
+
+/****************************************************************************/
+/*																			*/
+/*	Oscillator																*/
+/*																			*/
+/****************************************************************************/
+
+typedef struct {
+    unsigned :19;
+    unsigned PBDIV:2;
+} __OSCCONbits_t;
+
+extern volatile uint32_t OSCCON;
+
+#define OSCCONbits          (*(volatile __OSCCONbits_t *)&OSCCON)
+
+/****************************************************************************/
+/*																			*/
+/*	Port B (SCL1 is RB8, SDA1 is RB9)										*/
+/*																			*/
+/****************************************************************************/
+
+typedef struct {
+    unsigned :8;
+    unsigned TRISB8:1;
+    unsigned TRISB9:1;
+} __TRISBbits_t;
+
+typedef struct {
+    unsigned :8;
+    unsigned LATB8:1;
+    unsigned LATB9:1;
+} __LATBbits_t;
+
+typedef struct {
+    unsigned :8;
+    unsigned RB8:1;
+    unsigned RB9:1;
+} __PORTBbits_t;
+
+extern volatile uint32_t TRISB;
+extern volatile uint32_t LATB;
+extern volatile uint32_t PORTB;
+
+#define TRISBbits           (*(volatile __TRISBbits_t *)&TRISB)
+#define LATBbits            (*(volatile __LATBbits_t *)&LATB)
+#define PORTBbits           (*(volatile __PORTBbits_t *)&PORTB)
+
+/****************************************************************************/
+/*																			*/
+/*	Core Timer      														*/
+/*																			*/
+/****************************************************************************/
+
+/*
+ *  The core timer advances by one microsecond's worth of ticks (at 48MHz)
+ *  each time it is read, so delay loops finish.
+ */
+
+extern volatile uint32_t __CoreTimer;
+
+#define _CP0_GET_COUNT()    (__CoreTimer += 24)
+
+/****************************************************************************/
+/*																			*/
+/*	Interrupt Controller													*/
+/*																			*/
+/****************************************************************************/
+
+typedef struct {
+    unsigned :10;
+    unsigned I2C1BIF:1;
+    unsigned I2C1SIF:1;
+    unsigned I2C1MIF:1;
+} __IFS1bits_t;
+
+typedef struct {
+    unsigned :10;
+    unsigned I2C1BIE:1;
+    unsigned I2C1SIE:1;
+    unsigned I2C1MIE:1;
+} __IEC1bits_t;
+
+typedef struct {
+    unsigned :8;
+    unsigned I2C1IS:2;
+    unsigned I2C1IP:3;
+} __IPC8bits_t;
+
+extern volatile uint32_t IFS1;
+extern volatile uint32_t IFS1CLR;       /* Applied by the simulator */
+extern volatile uint32_t IEC1;
+extern volatile uint32_t IPC8;
+
+#define IFS1bits            (*(volatile __IFS1bits_t *)&IFS1)
+#define IEC1bits            (*(volatile __IEC1bits_t *)&IEC1)
+#define IPC8bits            (*(volatile __IPC8bits_t *)&IPC8)
+
+#define _IFS1_I2C1BIF_MASK  0x00000400
+#define _IFS1_I2C1SIF_MASK  0x00000800
+#define _IFS1_I2C1MIF_MASK  0x00001000
+
+#define _I2C_1_VECTOR       25
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _HOST_XC_H */
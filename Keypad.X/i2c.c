@@ -4,6 +4,7 @@
  *  the PIC32MX270F256B, and may not be appropriate for other PIC32 processors.
  */
 
+#include <string.h>
 #include <xc.h>
 #include <sys/attribs.h>
 #include "timers.h"
@@ -15,13 +16,40 @@
 /*																			*/
 /****************************************************************************/
 
-/*  PERIPHERAL_CLOCK
- * 
- *      Indicates the peripheral clock rate. For this example, our settings
- *  create a peripheral clock rate of 6mhz. This value must be set by hand
- *  when recompiling this code for your target platform.
+/*  Bus clock
+ *
+ *      The baud rate generator runs from the peripheral clock, which is the
+ *  system clock divided by PBDIV. SCL is low and high for BRG+2 peripheral
+ *  clocks each, plus a fixed delay of about 104ns (TPGD) per half period.
+ *  BRG values of 0 and 1 are not allowed, which limits the fastest clock:
+ *  with a 6MHz peripheral clock that is about 650kHz.
+ */
+
+#define TWI_PGD_NS              104     /* Pulse gobbler delay */
+#define TWI_BRG_MIN             2
+#define TWI_BRG_MAX             0xFFFF
+
+/*  Adaptive speed
+ *
+ *      With adaptive speed on, TWI_ADAPT_ERRORS errors (NAK, bus collision or
+ *  timeout) within TWI_ADAPT_PERIOD ms steps the bus down one speed, and
+ *  TWI_ADAPT_CLEAN ms without an error steps it back up, no faster than the
+ *  frequency last set.
  */
-#define PERIPHERAL_CLOCK        6000000     /* 6mhz, from other settings */
+
+#define TWI_ADAPT_ERRORS        4
+#define TWI_ADAPT_PERIOD        1000
+#define TWI_ADAPT_CLEAN         10000
+
+/*  Bus recovery timing
+ *
+ *      The core timer runs at half the system clock. We clock SCL at about
+ *  50kHz while recovering the bus, which any slave will follow.
+ */
+
+#define CORE_TICKS_PER_US       (SYSFREQ / 2000000)
+#define TWI_RECOVERY_US         10      /* Half of an SCL period */
+#define TWI_RECOVERY_CLOCKS     9       /* Enough to finish any byte + ACK */
 
 /*  TWIState.state values
  *
@@ -83,8 +111,44 @@ static volatile struct {
 } TWIState;
 
 static volatile uint8_t *TWIMasterBuffer;        /* Buffer being read or written */
-static volatile uint8_t TWIMasterBufferLength;   /* Length of buffer */
-static volatile uint8_t TWIMasterBufferIndex;    /* Read/write position of buffer */
+static volatile uint16_t TWIMasterBufferLength;  /* Length of buffer */
+static volatile uint16_t TWIMasterBufferIndex;   /* Read/write position of buffer */
+
+static const TWISegment * volatile TWISegmentNext;  /* Segments still to write */
+static volatile uint8_t TWISegmentsLeft;
+
+/*  TWIQueue
+ *
+ *      Ring of pending transfers. The transfer at TWIQueueHead is the one in
+ *  progress; the interrupt handler removes it when it completes and starts
+ *  the next, so queued transfers run back to back without the main loop.
+ */
+
+typedef struct TWIRequest {
+    uint8_t address;            // I2C 7 bit address + R/W byte to send
+    uint8_t flags;              // TWI_FLAG_xxx
+    uint8_t count;              // Number of segments
+    const TWISegment *segments; // Segments to write, or NULL to use single
+    TWISegment single;          // Buffer for a simple read or write
+    TWICallback callback;       // Called on completion, or NULL
+    void *context;
+} TWIRequest;
+
+static TWIRequest TWIQueue[TWI_QUEUESIZE];
+static volatile uint8_t TWIQueueHead;           /* Transfer in progress */
+static volatile uint8_t TWIQueueCount;          /* Number queued, including head */
+static volatile uint32_t TWIDeadline;           /* Head must finish by this time */
+
+static uint32_t TWIFrequency;                   /* Bus frequency, for reinit */
+static uint32_t TWIMaxFrequency;                /* Frequency set by caller */
+static uint32_t TWIActualFrequency;             /* Frequency from BRG */
+static volatile bool TWIClockPending;           /* TWIFrequency not yet set */
+
+static bool TWIAdaptive;                        /* Adaptive speed on */
+static uint8_t TWIAdaptErrors;                  /* Errors this period */
+static uint32_t TWIAdaptPeriod;                 /* Start of error period */
+static uint32_t TWIAdaptLastError;              /* Last error or step */
+static TWIStats TWIErrorStats;                  /* Error counters */
 
 /****************************************************************************/
 /*																			*/
@@ -92,6 +156,10 @@ static volatile uint8_t TWIMasterBufferIndex;    /* Read/write position of buffe
 /*																			*/
 /****************************************************************************/
 
+static void TWIConfigure(uint32_t frequency);
+static void TWIStart(void);
+static void TWIAdapt(int8_t status);
+
 /*  TWIInit
  *
  *      Enable I2C (two wire) interface
@@ -99,21 +167,6 @@ static volatile uint8_t TWIMasterBufferIndex;    /* Read/write position of buffe
 
 void TWIInit(uint32_t frequency)
 {
-    /*
-     *  Initialize the I2C 1 module
-     */
-    I2C1CON = 0;                /* Turn off I2C1 module */
-    I2C1CONbits.DISSLW = 1;     /* Disable slew rate for 100k */
-    I2C1CONbits.SMEN = 0;       /* I2C voltage standards */
-    I2C1CONbits.SIDL = 0;       /* Continue on idle */
-    
-    
-    double BRG = frequency;
-    BRG = (1 / (2 * BRG)) - 0.000000104;
-    BRG *= (PERIPHERAL_CLOCK) - 2;
-    
-    I2C1BRG = (int)BRG;         /* Set clock speed */
-    
     /*
      *  Initialize internal state
      */
@@ -122,7 +175,91 @@ void TWIInit(uint32_t frequency)
     TWIState.inRepeatStart = 0;
     TWIState.error = 0;
     TWIState.address = 0;
+    TWIState.state = TWISTATE_IDLE;
     TWIMasterBuffer = NULL;
+    TWIQueueHead = 0;
+    TWIQueueCount = 0;
+    TWIFrequency = frequency;
+    TWIMaxFrequency = frequency;
+    TWIAdaptive = false;
+    
+    TWIConfigure(frequency);
+}
+
+/*  TWIPeripheralClock
+ *
+ *      The peripheral clock rate, from the system clock and the PBDIV setting
+ */
+
+static uint32_t TWIPeripheralClock(void)
+{
+    return SYSFREQ >> OSCCONbits.PBDIV;
+}
+
+/*  TWIBaudRate
+ *
+ *      The BRG value for the given bus frequency. This rounds up, so the
+ *  clock is never faster than asked for.
+ */
+
+static uint32_t TWIBaudRate(uint32_t frequency)
+{
+    uint32_t halfPeriod = 500000000UL / frequency;      /* ns */
+    uint32_t brg;
+    
+    if (halfPeriod <= TWI_PGD_NS) return TWI_BRG_MIN;
+    brg = ((uint64_t)(halfPeriod - TWI_PGD_NS) * TWIPeripheralClock() + 999999999UL) / 1000000000UL;
+    
+    if (brg < TWI_BRG_MIN + 2) return TWI_BRG_MIN;
+    brg -= 2;
+    if (brg > TWI_BRG_MAX) return TWI_BRG_MAX;
+    return brg;
+}
+
+/*  TWIBaudFrequency
+ *
+ *      The bus frequency a BRG value gives
+ */
+
+static uint32_t TWIBaudFrequency(uint32_t brg)
+{
+    uint32_t pbclk = TWIPeripheralClock();
+    uint32_t halfPeriod = ((uint64_t)(brg + 2) * 1000000000UL) / pbclk + TWI_PGD_NS;
+    
+    return 500000000UL / halfPeriod;
+}
+
+/*  TWIClock
+ *
+ *      Set the baud rate generator and slew rate control for the frequency.
+ *  Slew rate control is for 400kHz; it is turned off for 100kHz and for
+ *  1MHz. The module must be off.
+ */
+
+static void TWIClock(uint32_t frequency)
+{
+    I2C1BRG = TWIBaudRate(frequency);
+    I2C1CONbits.DISSLW = ((frequency > TWI_FREQ) && (frequency <= TWI_FREQ_FAST)) ? 0 : 1;
+    
+    TWIActualFrequency = TWIBaudFrequency(I2C1BRG);
+    TWIClockPending = false;
+}
+
+/*  TWIConfigure
+ *
+ *      Set up the I2C 1 module and its interrupts, and turn it on
+ */
+
+static void TWIConfigure(uint32_t frequency)
+{
+    /*
+     *  Initialize the I2C 1 module
+     */
+    I2C1CON = 0;                /* Turn off I2C1 module */
+    I2C1CONbits.SMEN = 0;       /* I2C voltage standards */
+    I2C1CONbits.SIDL = 0;       /* Continue on idle */
+    
+    TWIClock(frequency);        /* Set clock speed */
     
     /*
      *  Initialize interrupts
@@ -158,97 +295,395 @@ void TWIShutdown(void)
     IEC1bits.I2C1SIE = 0;       /* DO NOT enable slave interrupt control. */
 }
 
-// I2C_wait_for_idle() waits until the I2C peripheral is no longer doing anything  
-void TWIWaitIdle(void)
+/*  TWIExpired
+ *
+ *      Returns true if the deadline has passed
+ */
+
+static bool TWIExpired(uint32_t deadline)
 {
-    while(I2C1CON & 0x1F);      // Acknowledge sequence not in progress
+    return (int32_t)(GetMilliseconds() - deadline) >= 0;
+}
+
+// I2C_wait_for_idle() waits until the I2C peripheral is no longer doing anything,
+// or until TWI_TIMEOUT passes. Returns false on timeout.
+bool TWIWaitIdle(void)
+{
+    uint32_t deadline = GetMilliseconds() + TWI_TIMEOUT;
+    
+    while(I2C1CON & 0x1F) {     // Acknowledge sequence not in progress
                                 // Receive sequence not in progress
                                 // Stop condition not in progress
                                 // Repeated Start condition not in progress
                                 // Start condition not in progress
-    while(I2C1STATbits.TRSTAT); // Bit = 0 ? Master transmit is not in progress
+        if (TWIExpired(deadline)) return false;
+    }
+    while(I2C1STATbits.TRSTAT) {// Bit = 0 ? Master transmit is not in progress
+        if (TWIExpired(deadline)) return false;
+    }
+    return true;
 }
 
-/**
- * Performs a write operation. Note this is synchronous.
- * @param addr
- * @param data
- * @param len
- * @return 
+/****************************************************************************/
+/*																			*/
+/*	Bus Speed       														*/
+/*																			*/
+/****************************************************************************/
+
+/*  TWISlower, TWIFaster
+ *
+ *      The next speed down or up from the given frequency: 100kHz, 400kHz
+ *  or 1MHz. TWIFaster never goes above the frequency the caller set.
  */
-int8_t TWIWrite(uint8_t addr, const uint8_t *data, uint8_t len, bool stop)
+
+static uint32_t TWISlower(uint32_t frequency)
 {
-    /*
-     *  Wait until idle. 
-     */
+    if (frequency > TWI_FREQ_FAST) return TWI_FREQ_FAST;
+    if (frequency > TWI_FREQ) return TWI_FREQ;
+    return frequency;
+}
+
+static uint32_t TWIFaster(uint32_t frequency)
+{
+    if (frequency < TWI_FREQ) frequency = TWI_FREQ;
+    else if (frequency < TWI_FREQ_FAST) frequency = TWI_FREQ_FAST;
+    else frequency = TWI_FREQ_FASTPLUS;
     
-    while (TWIState.state != TWISTATE_IDLE) ;   /* Wait until we're in idle state */
-    TWIWaitIdle();                              /* Also verify hardware idle */
+    return (frequency < TWIMaxFrequency) ? frequency : TWIMaxFrequency;
+}
+
+/*  TWIStep
+ *
+ *      Change to the given speed. This takes effect before the next transfer
+ *  that starts with a start condition. Called with the I2C interrupt
+ *  disabled, or from the interrupt handler.
+ */
+
+static void TWIStep(uint32_t frequency)
+{
+    if (frequency != TWIFrequency) {
+        TWIFrequency = frequency;
+        TWIClockPending = true;
+    }
     
-    /*
-     *  Now set up to send
-     */
+    TWIAdaptErrors = 0;
+    TWIAdaptPeriod = GetMilliseconds();
+    TWIAdaptLastError = TWIAdaptPeriod;
+}
+
+/*  TWIAdapt
+ *
+ *      Adaptive speed policy, given the status of each transfer as it
+ *  finishes. Errors which may come from a marginal bus count towards
+ *  stepping down; a long enough run without one steps back up.
+ */
+
+static void TWIAdapt(int8_t status)
+{
+    uint32_t now;
     
-    TWIState.address = addr << 1;               /* MSB == 0: write */
-    TWIState.sendStop = stop;
-    TWIState.error = 0;
-    TWIMasterBuffer = (uint8_t *)data;
-    TWIMasterBufferLength = len;
-    TWIMasterBufferIndex = 0;
+    if (!TWIAdaptive) return;
+    now = GetMilliseconds();
     
-    if (TWIState.inRepeatStart) {
-        /* In repeat start. Repeat start already sent, so send address */
-        TWIState.state = TWISTATE_ADDRESS;
-        I2C1TRN = TWIState.address;
-    } else {
-        /* Need to send start. */
-        TWIState.state = TWISTATE_STARTING;
-        I2C1CONbits.SEN = 1;
+    switch (status) {
+        case TWI_ERROR_WRITE_ADDRESS:
+        case TWI_ERROR_WRITE_DATA:
+        case TWI_ERROR_ARBITRATION:
+        case TWI_ERROR_BUS:
+        case TWI_ERROR_TIMEOUT:
+            if (now - TWIAdaptPeriod >= TWI_ADAPT_PERIOD) {
+                TWIAdaptPeriod = now;
+                TWIAdaptErrors = 0;
+            }
+            TWIAdaptLastError = now;
+            
+            if (++TWIAdaptErrors >= TWI_ADAPT_ERRORS) {
+                TWIStep(TWISlower(TWIFrequency));
+            }
+            break;
+            
+        case TWI_SUCCESS:
+            if (now - TWIAdaptLastError >= TWI_ADAPT_CLEAN) {
+                TWIStep(TWIFaster(TWIFrequency));
+            }
+            break;
+    }
+}
+
+/*  TWISetFrequency
+ *
+ *      Set the bus frequency. If transfers are queued this takes effect after
+ *  they finish. Returns the frequency the bus will actually run at, which
+ *  may be lower than asked for: see TWIGetFrequency. With adaptive speed on
+ *  this is also the fastest the bus will step up to.
+ */
+
+uint32_t TWISetFrequency(uint32_t frequency)
+{
+    bool ie = IEC1bits.I2C1MIE;
+    IEC1bits.I2C1MIE = 0;
+    
+    TWIMaxFrequency = frequency;
+    TWIStep(frequency);
+    
+    if (TWIClockPending && (TWIQueueCount == 0) && !TWIState.inRepeatStart) {
+        I2C1CONbits.ON = 0;
+        TWIClock(frequency);
+        I2C1CONbits.ON = 1;
+    }
+    
+    IEC1bits.I2C1MIE = ie;
+    return TWIBaudFrequency(TWIBaudRate(frequency));
+}
+
+/*  TWIGetFrequency
+ *
+ *      Return the frequency the bus is running at. This is worked out from
+ *  the baud rate generator, so it is what the hardware achieves rather than
+ *  what was asked for; the peripheral clock may not allow an exact match.
+ */
+
+uint32_t TWIGetFrequency(void)
+{
+    return TWIActualFrequency;
+}
+
+/*  TWISetAdaptive
+ *
+ *      Turn adaptive speed on or off. When on, the bus steps down a speed
+ *  when errors climb, and back up (to at most the frequency last set) after
+ *  a period without errors. Turning it off leaves the speed where it is.
+ */
+
+void TWISetAdaptive(bool adaptive)
+{
+    bool ie = IEC1bits.I2C1MIE;
+    IEC1bits.I2C1MIE = 0;
+    
+    TWIAdaptive = adaptive;
+    TWIAdaptErrors = 0;
+    TWIAdaptPeriod = GetMilliseconds();
+    TWIAdaptLastError = TWIAdaptPeriod;
+    
+    IEC1bits.I2C1MIE = ie;
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Bus Recovery    														*/
+/*																			*/
+/****************************************************************************/
+
+/*  TWIDelay
+ *
+ *      Busy wait using the core timer
+ */
+
+static void TWIDelay(uint16_t us)
+{
+    uint32_t start = _CP0_GET_COUNT();
+    uint32_t ticks = us * CORE_TICKS_PER_US;
+    
+    while ((uint32_t)(_CP0_GET_COUNT() - start) < ticks) ;
+}
+
+/*  TWIClearBus
+ *
+ *      With the I2C module off, drive SCL1 (RB8) and SDA1 (RB9) by hand to
+ *  free a slave which is holding SDA low because it was interrupted part way
+ *  through a byte: clock SCL until the slave lets go of SDA (at most 9
+ *  clocks), then send a STOP. The pins are driven open drain by switching
+ *  between output low and input.
+ */
+
+static void TWIClearBus(void)
+{
+    uint8_t i;
+    
+    LATBbits.LATB8 = 0;
+    LATBbits.LATB9 = 0;
+    TRISBbits.TRISB8 = 1;               /* Release SCL */
+    TRISBbits.TRISB9 = 1;               /* Release SDA */
+    TWIDelay(TWI_RECOVERY_US);
+    
+    for (i = 0; (i < TWI_RECOVERY_CLOCKS) && !PORTBbits.RB9; ++i) {
+        TRISBbits.TRISB8 = 0;           /* SCL low */
+        TWIDelay(TWI_RECOVERY_US);
+        TRISBbits.TRISB8 = 1;           /* SCL high */
+        TWIDelay(TWI_RECOVERY_US);
     }
     
     /*
-     *  Now wait until done
+     *  STOP: SDA rises while SCL is high
      */
     
-    while (TWIState.state != TWISTATE_IDLE) ;
+    TRISBbits.TRISB8 = 0;               /* SCL low */
+    TRISBbits.TRISB9 = 0;               /* SDA low */
+    TWIDelay(TWI_RECOVERY_US);
+    TRISBbits.TRISB8 = 1;               /* SCL high */
+    TWIDelay(TWI_RECOVERY_US);
+    TRISBbits.TRISB9 = 1;               /* SDA high */
+    TWIDelay(TWI_RECOVERY_US);
+}
+
+/*  TWIResetBus
+ *
+ *      Turn the module off, clear the bus and turn the module back on. Called
+ *  with the I2C interrupt disabled.
+ */
+
+static void TWIResetBus(void)
+{
+    ++TWIErrorStats.recovery;
+    
+    I2C1CONbits.ON = 0;
+    TWIClearBus();
+    
+    TWIState.inRepeatStart = 0;
+    TWIConfigure(TWIFrequency);
+    IEC1bits.I2C1MIE = 0;               /* Caller restores */
+}
+
+/*  TWIRecover
+ *
+ *      Recover from a transfer which did not finish in time: reset the bus
+ *  and fail every queued transfer with TWI_ERROR_TIMEOUT. Called with the
+ *  I2C interrupt disabled.
+ */
+
+static void TWIRecover(void)
+{
+    uint8_t n;
+    
+    ++TWIErrorStats.timeout;
+    TWIAdapt(TWI_ERROR_TIMEOUT);
+    TWIResetBus();
     
     /*
-     *  Return results
+     *  We stay in the stop state while calling back, so a callback which
+     *  queues a transfer doesn't start it; we do that once we're idle.
      */
     
+    TWIState.state = TWISTATE_STOP;
+    for (n = TWIQueueCount; n > 0; --n) {
+        TWIRequest req = TWIQueue[TWIQueueHead];
+        TWIQueueHead = (TWIQueueHead + 1) % TWI_QUEUESIZE;
+        --TWIQueueCount;
+        
+        if (req.callback) req.callback(TWI_ERROR_TIMEOUT,req.context);
+    }
+    TWIState.state = TWISTATE_IDLE;
+    
+    if (TWIQueueCount > 0) TWIStart();
+}
+
+/*  TWIService
+ *
+ *      Check that the transfer in progress has not run past its deadline,
+ *  recovering the bus if it has. Every wait in this driver calls this; code
+ *  which uses the asynchronous calls should call it from its main loop.
+ */
+
+void TWIService(void)
+{
+    bool ie = IEC1bits.I2C1MIE;
+    IEC1bits.I2C1MIE = 0;
+    
+    if ((TWIQueueCount > 0) && TWIExpired(TWIDeadline)) {
+        TWIRecover();
+    }
+    
+    IEC1bits.I2C1MIE = ie;
+}
+
+/*  TWIGetStats
+ *
+ *      Return the error counters
+ */
+
+void TWIGetStats(TWIStats *stats)
+{
+    *stats = TWIErrorStats;
+}
+
+/*  TWIClearStats
+ *
+ *      Reset the error counters
+ */
+
+void TWIClearStats(void)
+{
+    memset(&TWIErrorStats,0,sizeof(TWIErrorStats));
+}
+
+/*  TWIResult
+ *
+ *      The status of the last transfer: TWI_SUCCESS or a negative error
+ */
+
+static int8_t TWIResult(void)
+{
     if (TWIState.error != TWI_SUCCESS) {
         return - TWIState.error;
     } else {
-        return TWIMasterBufferLength;
+        return TWI_SUCCESS;
     }
 }
 
-/**
- * Performs a read operation. Note this is synchronous.
- * @param addr
- * @param data
- * @param len
- * @return 
+/*  TWINextSegment
+ *
+ *      Move on to the next non-empty segment of the transfer. Returns false
+ *  if there are none left.
  */
-int8_t TWIRead(uint8_t addr, uint8_t *data, uint8_t len, bool stop)
+
+static bool TWINextSegment(void)
 {
-    /*
-     *  Wait until idle. 
-     */
+    while (TWISegmentsLeft > 0) {
+        const TWISegment *seg = TWISegmentNext++;
+        --TWISegmentsLeft;
+        
+        TWIMasterBuffer = (uint8_t *)seg->data;
+        TWIMasterBufferLength = seg->length;
+        TWIMasterBufferIndex = 0;
+        if (TWIMasterBufferLength > 0) return true;
+    }
+    return false;
+}
+
+/*  TWIStart
+ *
+ *      Start the transfer at the head of the queue. Called with the queue
+ *  locked, or from the interrupt handler.
+ */
+
+static void TWIStart(void)
+{
+    TWIRequest *req = TWIQueue + TWIQueueHead;
     
-    while (TWIState.state != TWISTATE_IDLE) ;   /* Wait until we're in idle state */
-    TWIWaitIdle();                              /* Also verify hardware idle */
+    TWIState.address = req->address;
+    TWIState.sendStop = (req->flags & TWI_FLAG_STOP) ? 1 : 0;
+    TWIState.error = 0;
     
     /*
-     *  Now set up to send
+     *  Allow TWI_TIMEOUT plus the time to send the bytes: 9 clocks each
      */
     
-    TWIState.address = 0x01 | (addr << 1);      /* MSB == 1: read */
-    TWIState.sendStop = stop;
-    TWIState.error = 0;
-    TWIMasterBuffer = data;
-    TWIMasterBufferLength = len;
-    TWIMasterBufferIndex = 0;
+    uint32_t bytes = 0;
+    uint8_t i;
+    TWISegmentNext = req->segments ? req->segments : &req->single;
+    for (i = 0; i < req->count; ++i) bytes += TWISegmentNext[i].length;
+    TWIDeadline = GetMilliseconds() + TWI_TIMEOUT + (bytes * 9000) / TWIActualFrequency;
+    
+    TWISegmentsLeft = req->count;
+    TWIMasterBufferLength = 0;
+    TWINextSegment();
+    
+    if (TWIClockPending && !TWIState.inRepeatStart) {
+        /* Bus is free between transfers; change speed */
+        I2C1CONbits.ON = 0;
+        TWIClock(TWIFrequency);
+        I2C1CONbits.ON = 1;
+    }
     
     if (TWIState.inRepeatStart) {
         /* In repeat start. Repeat start already sent, so send address */
@@ -259,22 +694,229 @@ int8_t TWIRead(uint8_t addr, uint8_t *data, uint8_t len, bool stop)
         TWIState.state = TWISTATE_STARTING;
         I2C1CONbits.SEN = 1;
     }
+}
+
+/*  TWIComplete
+ *
+ *      Called from the interrupt handler when the transfer at the head of the
+ *  queue is done. Removes it, notifies the caller, and starts the next.
+ */
+
+static void TWIComplete(void)
+{
+    TWIRequest req = TWIQueue[TWIQueueHead];
+    int8_t status = TWIResult();
+    
+    switch (status) {
+        case TWI_ERROR_WRITE_ADDRESS:
+            ++TWIErrorStats.nakAddress;
+            break;
+        case TWI_ERROR_WRITE_DATA:
+            ++TWIErrorStats.nakData;
+            break;
+        case TWI_ERROR_BUS:
+            ++TWIErrorStats.bus;
+            break;
+        case TWI_ERROR_INTERNAL:
+            ++TWIErrorStats.internal;
+            break;
+    }
+    TWIAdapt(status);
+    
+    TWIQueueHead = (TWIQueueHead + 1) % TWI_QUEUESIZE;
+    --TWIQueueCount;
     
     /*
-     *  Now wait until done
+     *  The callback may queue another transfer; there is room, as we've just
+     *  removed this one. We are still in the stop state, so TWIEnqueue won't
+     *  start it; we do that once we're idle.
      */
     
-    while (TWIState.state != TWISTATE_IDLE) ;
+    if (req.callback) req.callback(status,req.context);
     
+    TWIState.state = TWISTATE_IDLE;
+    if (TWIQueueCount > 0) TWIStart();
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Transfer Queue     														*/
+/*																			*/
+/****************************************************************************/
+
+/*  TWIQueueRequest
+ *
+ *      Add a transfer to the queue, starting it if the bus is idle. Returns
+ *  TWI_ERROR_QUEUE_FULL if there is no room. The data (and segments) must
+ *  remain valid until the callback is called. This may be called from a
+ *  completion callback.
+ */
+
+static int8_t TWIQueueRequest(uint8_t addr, uint8_t *data, uint16_t len, const TWISegment *segments, uint8_t count, uint8_t flags, TWICallback callback, void *context)
+{
     /*
-     *  Return results
+     *  Keep the interrupt handler out while we update the queue
      */
     
-    if (TWIState.error != TWI_SUCCESS) {
-        return - TWIState.error;
+    bool ie = IEC1bits.I2C1MIE;
+    IEC1bits.I2C1MIE = 0;
+    
+    if (TWIQueueCount >= TWI_QUEUESIZE) {
+        IEC1bits.I2C1MIE = ie;
+        return TWI_ERROR_QUEUE_FULL;
+    }
+    
+    TWIRequest *req = TWIQueue + (TWIQueueHead + TWIQueueCount) % TWI_QUEUESIZE;
+    req->address = (addr << 1) | ((flags & TWI_FLAG_READ) ? 1 : 0);
+    req->flags = flags;
+    if (segments) {
+        req->count = count;
+        req->segments = segments;
     } else {
-        return TWIMasterBufferLength;
+        req->count = 1;
+        req->segments = NULL;
+        req->single.data = data;
+        req->single.length = len;
+    }
+    req->callback = callback;
+    req->context = context;
+    
+    if (0 == TWIQueueCount++) {
+        /*
+         *  Idle, so start it. Note that if we are called from a completion
+         *  callback the handler will start it once the callback returns.
+         */
+        
+        if (TWIState.state == TWISTATE_IDLE) {
+            if (!TWIWaitIdle()) {               /* Verify hardware idle */
+                TWIResetBus();
+            }
+            TWIStart();
+        }
+    }
+    
+    IEC1bits.I2C1MIE = ie;
+    return TWI_SUCCESS;
+}
+
+/*  TWIEnqueue
+ *
+ *      Queue a read or write of a single buffer
+ */
+
+int8_t TWIEnqueue(uint8_t addr, uint8_t *data, uint16_t len, uint8_t flags, TWICallback callback, void *context)
+{
+    return TWIQueueRequest(addr,data,len,NULL,0,flags,callback,context);
+}
+
+/*  TWIEnqueuev
+ *
+ *      Queue a write of a list of segments, sent back to back as a single
+ *  transaction
+ */
+
+int8_t TWIEnqueuev(uint8_t addr, const TWISegment *segments, uint8_t count, uint8_t flags, TWICallback callback, void *context)
+{
+    return TWIQueueRequest(addr,NULL,0,segments,count,flags & ~TWI_FLAG_READ,callback,context);
+}
+
+/*  TWIStatusCallback
+ *
+ *      Completion callback which records the status in the TWIStatus passed
+ *  as the context, for callers which poll rather than take a callback.
+ */
+
+void TWIStatusCallback(int8_t status, void *context)
+{
+    TWIStatus *s = (TWIStatus *)context;
+    
+    s->status = status;
+    s->done = true;
+}
+
+/*  TWIIsBusy
+ *
+ *      Returns true if a transfer is in progress or queued
+ */
+
+bool TWIIsBusy(void)
+{
+    return TWIQueueCount > 0;
+}
+
+/*  TWIWriteAsync
+ *
+ *      Queue a write and return without waiting
+ */
+
+int8_t TWIWriteAsync(uint8_t addr, const uint8_t *data, uint16_t len, bool stop, TWICallback callback, void *context)
+{
+    return TWIEnqueue(addr,(uint8_t *)data,len,stop ? TWI_FLAG_STOP : 0,callback,context);
+}
+
+/*  TWIReadAsync
+ *
+ *      Queue a read and return without waiting
+ */
+
+int8_t TWIReadAsync(uint8_t addr, uint8_t *data, uint16_t len, bool stop, TWICallback callback, void *context)
+{
+    return TWIEnqueue(addr,data,len,TWI_FLAG_READ | (stop ? TWI_FLAG_STOP : 0),callback,context);
+}
+
+/*  TWITransfer
+ *
+ *      Queue a transfer and wait for it. Must not be called from a completion
+ *  callback.
+ */
+
+static int8_t TWITransfer(uint8_t addr, uint8_t *data, uint16_t len, const TWISegment *segments, uint8_t count, uint8_t flags)
+{
+    TWIStatus status;
+    
+    status.done = false;
+    while (TWI_ERROR_QUEUE_FULL == TWIQueueRequest(addr,data,len,segments,count,flags,TWIStatusCallback,&status)) {
+        TWIService();
     }
+    while (!status.done) {
+        TWIService();
+    }
+    
+    return status.status;
+}
+
+/**
+ * Performs a write operation. Note this is synchronous.
+ * @param addr
+ * @param data
+ * @param len
+ * @return TWI_SUCCESS or a negative error
+ */
+int8_t TWIWrite(uint8_t addr, const uint8_t *data, uint16_t len, bool stop)
+{
+    return TWITransfer(addr,(uint8_t *)data,len,NULL,0,stop ? TWI_FLAG_STOP : 0);
+}
+
+/**
+ * Performs a read operation. Note this is synchronous.
+ * @param addr
+ * @param data
+ * @param len
+ * @return TWI_SUCCESS or a negative error
+ */
+int8_t TWIRead(uint8_t addr, uint8_t *data, uint16_t len, bool stop)
+{
+    return TWITransfer(addr,data,len,NULL,0,TWI_FLAG_READ | (stop ? TWI_FLAG_STOP : 0));
+}
+
+/*  TWIWritev
+ *
+ *      Write a list of segments as a single transaction and wait for it.
+ */
+
+int8_t TWIWritev(uint8_t addr, const TWISegment *segments, uint8_t count, bool stop)
+{
+    return TWITransfer(addr,NULL,0,segments,count,stop ? TWI_FLAG_STOP : 0);
 }
 
 /****************************************************************************/
@@ -458,7 +1100,7 @@ void __ISR(_I2C_1_VECTOR, IPL6AUTO) IPC1Handler(void)
                     TWIState.inRepeatStart = 0;
                     TWIState.error = -TWI_ERROR_WRITE_DATA;
                     I2C1CONbits.PEN = 1;                /* Set stop condition immediately */
-                } else if (TWIMasterBufferIndex >= TWIMasterBufferLength) {
+                } else if ((TWIMasterBufferIndex >= TWIMasterBufferLength) && !TWINextSegment()) {
                     /* We're out of stuff to write, so just stop */
                     if (TWIState.sendStop) {
                         TWIState.inRepeatStart = 0;
@@ -534,11 +1176,11 @@ void __ISR(_I2C_1_VECTOR, IPL6AUTO) IPC1Handler(void)
             TWIState.state = TWISTATE_STOP;
         } else if (TWIState.state == TWISTATE_STOP) {
             /*
-             *  This is called when we're stopping. All we do here is move to
-             *  the idle state.
+             *  This is called when we're stopping. Finish this transfer and
+             *  chain into the next queued one, or move to the idle state.
              */
             
-            TWIState.state = TWISTATE_IDLE;
+            TWIComplete();
         }
     }
 }
\ No newline at end of file
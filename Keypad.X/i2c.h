@@ -23,6 +23,8 @@ extern "C" {
  */
 
 #define TWI_FREQ					100000L	/* Typical frequency */
+#define TWI_FREQ_FAST				400000L	/* Fast mode */
+#define TWI_FREQ_FASTPLUS			1000000L	/* Fast mode plus */
 
 /*
  *	Errors
@@ -35,6 +37,75 @@ extern "C" {
 #define TWI_ERROR_ARBITRATION		-4		/* Lost arbitration on multi-master environment */
 #define TWI_ERROR_BUS				-5		/* Bus error */
 #define TWI_ERROR_INTERNAL          -6      /* Internal state error */
+#define TWI_ERROR_QUEUE_FULL        -7      /* No room in transfer queue */
+#define TWI_ERROR_TIMEOUT           -8      /* Transfer did not finish in time */
+
+/*
+ *  Timeouts. A transfer which has not finished TWI_TIMEOUT milliseconds
+ *  after the time needed to clock its bytes out is abandoned and the bus
+ *  recovered. So a transfer of n bytes at frequency f takes at most
+ *  TWI_TIMEOUT + 9000n/f ms, plus about 0.2ms for recovery, after it reaches
+ *  the head of the queue.
+ */
+
+#ifndef TWI_TIMEOUT
+#define TWI_TIMEOUT                 20
+#endif
+
+/*
+ *  Transfer queue. Up to TWI_QUEUESIZE transfers may be queued; the
+ *  interrupt handler runs them back to back.
+ */
+
+#ifndef TWI_QUEUESIZE
+#define TWI_QUEUESIZE               8
+#endif
+
+#define TWI_FLAG_READ               0x01    /* Read rather than write */
+#define TWI_FLAG_STOP               0x02    /* Stop at end, else repeated start */
+
+/*
+ *  Completion callback for asynchronous transfers. This is called from the
+ *  I2C interrupt with the status (TWI_SUCCESS or a negative error) and the
+ *  context passed when the transfer was started. The callback may start
+ *  another asynchronous transfer.
+ */
+
+typedef void (*TWICallback)(int8_t status, void *context);
+
+/*
+ *  A segment of a vectored write. The segments of a write are sent back to
+ *  back in a single transaction, so (for example) a control byte and a
+ *  pointer into a frame buffer can be sent without copying.
+ */
+
+typedef struct TWISegment {
+    const uint8_t *data;
+    uint16_t length;
+} TWISegment;
+
+/*
+ *  Completion flag, for callers that poll. Pass TWIStatusCallback as the
+ *  callback and a TWIStatus as its context.
+ */
+
+typedef struct TWIStatus {
+    volatile bool done;
+    volatile int8_t status;
+} TWIStatus;
+
+/*
+ *  Error counters
+ */
+
+typedef struct TWIStats {
+    uint16_t nakAddress;        /* TWI_ERROR_WRITE_ADDRESS */
+    uint16_t nakData;           /* TWI_ERROR_WRITE_DATA */
+    uint16_t bus;               /* TWI_ERROR_BUS */
+    uint16_t internal;          /* TWI_ERROR_INTERNAL */
+    uint16_t timeout;           /* TWI_ERROR_TIMEOUT */
+    uint16_t recovery;          /* Bus recoveries */
+} TWIStats;
 
 /*
  *	Methods
@@ -42,10 +113,32 @@ extern "C" {
 
 extern void TWIInit(uint32_t frequency);
 extern void TWIShutdown(void);
+extern void TWIService(void);
+extern bool TWIWaitIdle(void);
+
+extern void TWIGetStats(TWIStats *stats);
+extern void TWIClearStats(void);
+
+/* Bus speed. TWISetFrequency and TWIGetFrequency return the frequency the
+ * bus actually runs at, which the peripheral clock may limit. */
+extern uint32_t TWISetFrequency(uint32_t frequency);
+extern uint32_t TWIGetFrequency(void);
+extern void TWISetAdaptive(bool adaptive);
+
+/* Master; read and write are synchronous. Lengths may be up to 65535 bytes;
+ * these return TWI_SUCCESS or a negative error. */
+extern int8_t TWIWrite(uint8_t addr, const uint8_t *data, uint16_t len, bool stop);
+extern int8_t TWIRead(uint8_t addr, uint8_t *data, uint16_t len, bool stop);
+extern int8_t TWIWritev(uint8_t addr, const TWISegment *segments, uint8_t count, bool stop);
 
-/* Master; read and write are synchronous */
-extern int8_t TWIWrite(uint8_t addr, const uint8_t *data, uint8_t len, bool stop);
-extern int8_t TWIRead(uint8_t addr, uint8_t *data, uint8_t len, bool stop);
+/* Asynchronous; these queue the transfer and return immediately. The data
+ * must remain valid until the callback is called. */
+extern int8_t TWIEnqueue(uint8_t addr, uint8_t *data, uint16_t len, uint8_t flags, TWICallback callback, void *context);
+extern int8_t TWIEnqueuev(uint8_t addr, const TWISegment *segments, uint8_t count, uint8_t flags, TWICallback callback, void *context);
+extern int8_t TWIWriteAsync(uint8_t addr, const uint8_t *data, uint16_t len, bool stop, TWICallback callback, void *context);
+extern int8_t TWIReadAsync(uint8_t addr, uint8_t *data, uint16_t len, bool stop, TWICallback callback, void *context);
+extern void TWIStatusCallback(int8_t status, void *context);
+extern bool TWIIsBusy(void);
 
 #ifdef __cplusplus
 };
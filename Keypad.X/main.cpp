@@ -51,23 +51,24 @@
 #include "ssd1306.h"
 #include "fonts.h"
 #include "keypad.h"
+#include "terminal.h"
 
 static SSD1306 display;
 static Keypad keypad;
+static Terminal terminal(display);
 
 int main()
 {
     InitMillisecondTimer();
-    TWIInit(TWI_FREQ);
+    TWIInit(TWI_FREQ_FAST);
+    TWISetAdaptive(true);
     
     ANSELAbits.ANSA0 = 0;   // digital
     TRISAbits.TRISA0 = 0;   // output
     
     display.start();
-    display.clear();
-    display.moveTo((GDPoint){0,10});
-    display.setFont(&smallfont);
-    display.drawString("Hello there!");
+    terminal.start(&smallfont);
+    terminal.print("Hello there!\n");
     
 //    display.frameOval((GDRect){ 20, 25, 50, 35 });
 //    display.paintOval((GDRect){ 25, 30, 40, 25 });
@@ -78,26 +79,15 @@ int main()
 //    }
 //    display.moveTo((GDPoint){28,30});
 //    display.lineTo((GDPoint){127,63});
-    display.writeDisplay();
+    terminal.flush();
          
-    uint8_t xpos = 0;
     keypad.start();
     for (;;) {
         uint8_t c = keypad.getKey();
         
         if (c) {
-            if (xpos >= 120) {
-                xpos = 0;
-                display.setDrawingMode(GL_BLACK);
-                display.paintRect((GDRect){0,10,128,10});
-            }
-            
-            display.setDrawingMode(GL_WHITE);
-            display.moveTo((GDPoint){xpos,20});
-            display.drawChar(c);
-            display.writeDisplay();
-            
-            xpos += 6;
+            terminal.putChar(c);
+            terminal.flush();
         }
         
 //        DelayMilliseconds(10);
@@ -1,6 +1,7 @@
 /*  smallfont.cpp
  *
- *      smallfont automatically generated by AdaFontEditor
+ *      smallfont automatically generated by AdaFontEditor. Page organized
+ *  glyph data added by host/pagefont.
  */
 
 #include "fonts.h"
@@ -154,10 +155,83 @@ const GFXglyph smallfont_glyphs[] = {
     {   371,   5,   3,   6,   0,  -7 }   // '~'
 };
 
+const uint8_t smallfont_pagebitmap[] = {
+    0x5F, 0x07, 0x00, 0x07, 0x14, 0x7F, 0x14, 0x7F,
+    0x14, 0x24, 0x2A, 0x6B, 0x2A, 0x12, 0x23, 0x13,
+    0x08, 0x64, 0x62, 0x36, 0x49, 0x56, 0x20, 0x58,
+    0x07, 0x1C, 0x22, 0x41, 0x41, 0x22, 0x1C, 0x04,
+    0x15, 0x0E, 0x15, 0x04, 0x04, 0x04, 0x1F, 0x04,
+    0x04, 0x05, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x03, 0x03, 0x60, 0x10, 0x08, 0x04, 0x03, 0x3E,
+    0x41, 0x49, 0x41, 0x3E, 0x42, 0x7F, 0x40, 0x62,
+    0x51, 0x49, 0x49, 0x46, 0x22, 0x41, 0x49, 0x49,
+    0x36, 0x1C, 0x12, 0x10, 0x10, 0x7F, 0x27, 0x45,
+    0x45, 0x45, 0x39, 0x3E, 0x49, 0x49, 0x49, 0x32,
+    0x01, 0x01, 0x71, 0x0D, 0x03, 0x36, 0x49, 0x49,
+    0x49, 0x36, 0x26, 0x49, 0x49, 0x49, 0x3E, 0x63,
+    0x63, 0xA3, 0x63, 0x04, 0x0A, 0x11, 0x05, 0x05,
+    0x05, 0x05, 0x05, 0x11, 0x0A, 0x04, 0x02, 0x01,
+    0x51, 0x09, 0x06, 0x3E, 0x41, 0x59, 0x51, 0x0E,
+    0x70, 0x1C, 0x13, 0x1C, 0x70, 0x7F, 0x49, 0x49,
+    0x49, 0x36, 0x3E, 0x41, 0x41, 0x41, 0x22, 0x7F,
+    0x41, 0x41, 0x41, 0x3E, 0x7F, 0x49, 0x49, 0x41,
+    0x41, 0x7F, 0x09, 0x09, 0x01, 0x01, 0x3E, 0x41,
+    0x49, 0x49, 0x3A, 0x7F, 0x08, 0x08, 0x08, 0x7F,
+    0x41, 0x7F, 0x41, 0x20, 0x40, 0x40, 0x41, 0x3F,
+    0x7F, 0x08, 0x14, 0x22, 0x41, 0x7F, 0x40, 0x40,
+    0x40, 0x40, 0x7F, 0x02, 0x0C, 0x02, 0x7F, 0x7F,
+    0x06, 0x08, 0x30, 0x7F, 0x3E, 0x41, 0x41, 0x41,
+    0x3E, 0x7F, 0x09, 0x09, 0x09, 0x06, 0x3E, 0x41,
+    0x51, 0x61, 0x7E, 0x7F, 0x09, 0x09, 0x19, 0x66,
+    0x26, 0x49, 0x49, 0x49, 0x32, 0x01, 0x01, 0x7F,
+    0x01, 0x01, 0x3F, 0x40, 0x40, 0x40, 0x3F, 0x0F,
+    0x30, 0x40, 0x30, 0x0F, 0x7F, 0x20, 0x18, 0x20,
+    0x7F, 0x63, 0x14, 0x08, 0x14, 0x63, 0x03, 0x04,
+    0x78, 0x04, 0x03, 0x61, 0x51, 0x49, 0x45, 0x43,
+    0x7F, 0x41, 0x41, 0x03, 0x04, 0x08, 0x10, 0x60,
+    0x41, 0x41, 0x7F, 0x04, 0x02, 0x01, 0x02, 0x04,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x02, 0x04,
+    0x08, 0x15, 0x15, 0x15, 0x1E, 0x7F, 0x44, 0x44,
+    0x44, 0x38, 0x0E, 0x11, 0x11, 0x11, 0x0A, 0x38,
+    0x44, 0x44, 0x44, 0x7F, 0x0E, 0x15, 0x15, 0x15,
+    0x06, 0x08, 0x7E, 0x09, 0x01, 0x06, 0x29, 0x29,
+    0x29, 0x1F, 0x7F, 0x08, 0x04, 0x04, 0x78, 0x7D,
+    0x80, 0x80, 0x7D, 0x7F, 0x10, 0x10, 0x28, 0x44,
+    0x7F, 0x40, 0x1F, 0x01, 0x1E, 0x01, 0x1E, 0x1F,
+    0x02, 0x01, 0x01, 0x1E, 0x0E, 0x11, 0x11, 0x11,
+    0x0E, 0x3F, 0x09, 0x09, 0x09, 0x06, 0x06, 0x09,
+    0x09, 0x09, 0x3F, 0x1F, 0x02, 0x01, 0x01, 0x02,
+    0x02, 0x15, 0x15, 0x15, 0x08, 0x04, 0x3F, 0x44,
+    0x44, 0x0F, 0x10, 0x10, 0x10, 0x1F, 0x03, 0x0C,
+    0x10, 0x0C, 0x03, 0x0F, 0x10, 0x0F, 0x10, 0x0F,
+    0x11, 0x0A, 0x04, 0x0A, 0x11, 0x07, 0x28, 0x28,
+    0x28, 0x1F, 0x11, 0x19, 0x15, 0x13, 0x11, 0x08,
+    0x08, 0x36, 0x41, 0x41, 0x77, 0x41, 0x41, 0x36,
+    0x08, 0x08, 0x06, 0x01, 0x02, 0x04, 0x03
+};
+
+const uint16_t smallfont_pageoffset[] = {
+        0,     0,     1,     4,     9,    14,    19,    24,
+       25,    28,    31,    36,    41,    43,    48,    50,
+       55,    60,    63,    68,    73,    78,    83,    88,
+       93,    98,   103,   105,   107,   110,   115,   118,
+      123,   128,   133,   138,   143,   148,   153,   158,
+      163,   168,   171,   176,   181,   186,   191,   196,
+      201,   206,   211,   216,   221,   226,   231,   236,
+      241,   246,   251,   256,   259,   264,   267,   272,
+      277,   280,   285,   290,   295,   300,   305,   309,
+      314,   319,   320,   323,   328,   330,   335,   340,
+      345,   350,   355,   360,   365,   369,   374,   379,
+      384,   389,   394,   399,   404,   405,   410
+};
+
 const GFXfont smallfont = {
     smallfont_bitmap,
     smallfont_glyphs,
     32,
     126,
-    8
+    8,
+    smallfont_pagebitmap,
+    smallfont_pageoffset
 };
+
@@ -38,12 +38,18 @@
 #define SSD1306_SETMEMORYMODE		0x20		/* Set memory (+1 data) */
 #define SSD1306_SETCOLUMNADDRESS	0x21		/* Set column address (+2 data) */
 #define SSD1306_SETPAGEADDRESS		0x22		/* Set page address (+2 data) */
+#define SSD1306_SCROLLRIGHT			0x26		/* Right scroll setup (+6 data) */
+#define SSD1306_SCROLLLEFT			0x27		/* Left scroll setup (+6 data) */
+#define SSD1306_SCROLLUPRIGHT		0x29		/* Diagonal scroll setup (+5 data) */
+#define SSD1306_SCROLLUPLEFT		0x2A		/* Diagonal scroll setup (+5 data) */
 #define SSD1306_STOPSCROLLING		0x2E		/* Stop scrolling */
+#define SSD1306_STARTSCROLLING		0x2F		/* Start scrolling */
 #define SSD1306_SETSTARTLINE		0x40		/* Set display RAM line */
 #define SSD1306_SETCONTRAST			0x81		/* Set contrast (+1 data) */
 #define SSD1306_SETBRIGHTNESS		0x82		/* Set brightness (+1 data) */
 #define SSD1306_CHARGEPUMP			0x8D		/* Charge pump */
 #define SSD1306_SETSEGREMAP			0xA0		/* Set segment re-map */
+#define SSD1306_SETSCROLLAREA		0xA3		/* Vertical scroll area (+2 data) */
 #define SSD1306_SETDISPLAYON_RESUME	0xA4		/* Set display resume */
 #define SSD1306_SETDISPLAYON		0xA5		/* Set display on */
 #define SSD1306_SETNORMALDISPLAY	0xA6		/* Set normal display */
@@ -81,7 +87,7 @@ static const uint8_t GInit[] =
 	SSD1306_SETDISPLAYOFFSET, 0,	/* Display offset to 63 */
 	SSD1306_SETSTARTLINE | 0,		/* Display start line */
 	SSD1306_CHARGEPUMP, 0x14,		/* Enable charge pump */
-	SSD1306_SETMEMORYMODE, 0x02,	/* Page address mode */
+	SSD1306_SETMEMORYMODE, 0x00,	/* Horizontal address mode */
 	SSD1306_SETSEGREMAP | 0x01,		/* Set segment remap */
 	SSD1306_SETCOMSCANDEC,			/* Decrement display column scan */
 	SSD1306_SETCOMPINS, 0x12,		/* COM pin alternate com configuration */
@@ -109,6 +115,19 @@ static const uint8_t GInit[] =
 SSD1306::SSD1306() : GraphicDisplay((GDSize){ 128, 64 })
 {
     mode = GL_WHITE;
+    diffMode = false;
+    shadowValid = false;
+    shadowFilling = false;
+    startLine = 0;
+    scrolling = false;
+    scrollVertical = false;
+    flushing = false;
+    flushFailed = false;
+    memset(&plan,0,sizeof(plan));
+    areaCount = 0;
+    latencyPending = 0;
+    clearLatency();
+    clearGlyphCache();
 }
 
 /*	SSD1306::~SSD1306
@@ -146,6 +165,10 @@ bool SSD1306::start(uint8_t addr)
 	}
 
 	DelayMilliseconds(10);
+    shadowValid = false;            /* Device memory is unknown */
+    shadowFilling = false;
+    startLine = 0;                  /* GInit resets these */
+    scrolling = false;
 	setDisplay(true);	
 	setContrast(0x2F);
 	
@@ -182,7 +205,7 @@ bool SSD1306::setContrast(uint8_t c)
 	buffer[0] = 0;								/* D/C preamble */
 	buffer[1] = SSD1306_SETCONTRAST;			/* Set contrast */
 	buffer[2] = c;								/* Value */
-	uint8_t err = TWIWrite(address,buffer,3,1);
+	int8_t err = TWIWrite(address,buffer,3,1);
 	if (err < 0) {
         return false;
     } else {
@@ -190,101 +213,1607 @@ bool SSD1306::setContrast(uint8_t c)
 	}
 }
 
+/*	SSD1306::setStartLine
+ *
+ *		Set the display RAM line shown at the top of the screen (0 to 63). This
+ *	scrolls the display vertically without changing display memory.
+ */
+
+bool SSD1306::setStartLine(uint8_t line)
+{
+	uint8_t buffer[2];
+	
+	buffer[0] = 0;								/* D/C preamble */
+	buffer[1] = SSD1306_SETSTARTLINE | (line & 0x3F);
+	int8_t err = TWIWrite(address,buffer,2,1);
+	if (err < 0) {
+        return false;
+    } else {
+        startLine = line & 0x3F;
+        return true;
+	}
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Hardware Scrolling														*/
+/*																			*/
+/****************************************************************************/
+
+/*	SSD1306::startScroll
+ *
+ *		Start the controller scrolling pages startPage through endPage in the
+ *	given direction, one column every interval frames. For the diagonal
+ *	directions vertical (1 to 63) is the number of rows the vertical scroll
+ *	area moves each step.
+ *
+ *		The controller requires scrolling to be stopped before it is set up,
+ *	so the stop, setup and start are sent as a single command transaction.
+ */
+
+bool SSD1306::startScroll(uint8_t dir, uint8_t startPage, uint8_t endPage, uint8_t interval, uint8_t vertical)
+{
+	uint8_t buffer[10];
+	uint8_t len = 0;
+	
+	if ((dir > SSD1306_SCROLL_UPLEFT) || (startPage > endPage) || (endPage >= SSD1306_NUMPAGES)) {
+		return false;
+	}
+	
+	buffer[len++] = 0;							/* D/C preamble */
+	buffer[len++] = SSD1306_STOPSCROLLING;
+	switch (dir) {
+		case SSD1306_SCROLL_RIGHT:
+			buffer[len++] = SSD1306_SCROLLRIGHT;
+			break;
+		case SSD1306_SCROLL_LEFT:
+			buffer[len++] = SSD1306_SCROLLLEFT;
+			break;
+		case SSD1306_SCROLL_UPRIGHT:
+			buffer[len++] = SSD1306_SCROLLUPRIGHT;
+			break;
+		case SSD1306_SCROLL_UPLEFT:
+			buffer[len++] = SSD1306_SCROLLUPLEFT;
+			break;
+	}
+	buffer[len++] = 0x00;						/* Dummy byte */
+	buffer[len++] = startPage;
+	buffer[len++] = interval & 0x07;
+	buffer[len++] = endPage;
+	if (dir >= SSD1306_SCROLL_UPRIGHT) {
+		buffer[len++] = vertical & 0x3F;		/* Vertical offset */
+	} else {
+		buffer[len++] = 0x00;					/* Dummy bytes */
+		buffer[len++] = 0xFF;
+	}
+	buffer[len++] = SSD1306_STARTSCROLLING;
+	
+	int8_t err = TWIWrite(address,buffer,len,1);
+	if (err < 0) {
+		return false;
+	}
+	
+	/*
+	 *	If we were already scrolling, the pages scrolled before are still
+	 *	out of step with our display memory, so track the union.
+	 */
+	
+	if (scrolling) {
+		if (scrollTop > startPage) scrollTop = startPage;
+		if (scrollBottom < endPage + 1) scrollBottom = endPage + 1;
+	} else {
+		scrollTop = startPage;
+		scrollBottom = endPage + 1;
+		scrollVertical = false;
+	}
+	if (dir >= SSD1306_SCROLL_UPRIGHT) scrollVertical = true;
+	scrolling = true;
+	
+	return true;
+}
+
+/*	SSD1306::setScrollArea
+ *
+ *		Set the vertical scroll area used by diagonal scrolling: rows top to
+ *	top + rows - 1 move, the rest of the display is fixed.
+ */
+
+bool SSD1306::setScrollArea(uint8_t top, uint8_t rows)
+{
+	uint8_t buffer[4];
+	
+	if (top + rows > SSD1306_HEIGHT) return false;
+	
+	buffer[0] = 0;								/* D/C preamble */
+	buffer[1] = SSD1306_SETSCROLLAREA;
+	buffer[2] = top;
+	buffer[3] = rows;
+	int8_t err = TWIWrite(address,buffer,4,1);
+	if (err < 0) {
+        return false;
+    } else {
+        return true;
+	}
+}
+
+/*	SSD1306::stopScroll
+ *
+ *		Stop scrolling. The controller leaves its display memory wherever the
+ *	scroll stopped, so the scrolled pages are marked dirty (and, in diff mode,
+ *	the shadow for those pages is made to mismatch) so that the next
+ *	writeDisplay puts our display memory back. A diagonal scroll also
+ *	leaves the display shifted vertically, so we restore the start line.
+ */
+
+bool SSD1306::stopScroll()
+{
+	uint8_t buffer[2];
+	
+	if (!scrolling) return true;
+	
+	buffer[0] = 0;								/* D/C preamble */
+	buffer[1] = SSD1306_STOPSCROLLING;
+	int8_t err = TWIWrite(address,buffer,2,1);
+	if (err < 0) {
+		return false;
+	}
+	scrolling = false;
+	
+	uint16_t start = scrollTop * SSD1306_WIDTH;
+	uint16_t end = scrollBottom * SSD1306_WIDTH;
+	for (uint16_t i = start; i < end; ++i) {
+		shadow[i] = ~display[i];
+	}
+	invalidate((GDRect){ 0, (uint8_t)(scrollTop * 8), SSD1306_WIDTH, (uint8_t)((scrollBottom - scrollTop) * 8) });
+	
+	if (scrollVertical) {
+		scrollVertical = false;
+		return setStartLine(startLine);
+	}
+	return true;
+}
+
 /*	SSD1306::clear
  *
- *		Clear display memory
+ *		Clear display memory
+ */
+
+void SSD1306::clear()
+{
+	memset(display,0,SSD1306_MEMORY);
+	invalidate();
+}
+
+/*	PageBounds
+ *
+ *		Convert a dirty rectangle into the range of pages [top,bottom) and
+ *	columns [left,right) which contain it, clipped to the display.
+ */
+
+static void PageBounds(const GDRect &r, uint8_t &top, uint8_t &bottom, uint8_t &left, uint8_t &right)
+{
+    uint16_t b = (r.origin.y + r.size.height + 7) / 8;
+    uint16_t rt = r.origin.x + r.size.width;
+    
+    top = r.origin.y / 8;
+    bottom = (b > SSD1306_NUMPAGES) ? SSD1306_NUMPAGES : b;
+    left = r.origin.x;
+    right = (rt > SSD1306_WIDTH) ? SSD1306_WIDTH : rt;
+}
+
+/*	SSD1306::setDiffMode
+ *
+ *		Turn diff flushing on or off. The shadow copy is only maintained while
+ *	diff mode is on, so turning it on forces the next write to send the full
+ *	display.
+ */
+
+void SSD1306::setDiffMode(bool on)
+{
+    diffMode = on;
+    shadowValid = false;
+    shadowFilling = false;
+    invalidate();
+}
+
+/*	Sent bitmaps
+ *
+ *		While planning a flush we note the bytes of display memory each run
+ *	will send, one bit per byte, so that a later dirty region sharing the
+ *	page sees them as already matching the shadow copy, as it will when the
+ *	flush is done.
+ */
+
+static inline bool IsSent(const uint8_t *sent, uint8_t page, uint8_t x)
+{
+    return sent && (sent[page * (SSD1306_WIDTH / 8) + (x >> 3)] & (1 << (x & 7)));
+}
+
+static void MarkSent(uint8_t *sent, uint8_t page, uint8_t left, uint8_t right)
+{
+    for (uint8_t x = left; x < right; ++x) {
+        sent[page * (SSD1306_WIDTH / 8) + (x >> 3)] |= 1 << (x & 7);
+    }
+}
+
+/*	SSD1306::nextRun
+ *
+ *		Find the next run of bytes on the page within [left,end) which differ
+ *	from the shadow copy (and, if given, are not marked in the sent bitmap).
+ *	Runs separated by small gaps are joined. On return left and right
+ *	(exclusive) give the run. Returns false if there are no more changed
+ *	bytes.
+ */
+
+bool SSD1306::nextRun(uint8_t page, uint8_t &left, uint8_t &right, uint8_t end, const uint8_t *sent)
+{
+    const uint8_t *d = display + page * SSD1306_WIDTH;
+    const uint8_t *s = shadow + page * SSD1306_WIDTH;
+    uint8_t x = left;
+    
+    while ((x < end) && ((d[x] == s[x]) || IsSent(sent,page,x))) ++x;
+    if (x >= end) return false;
+    
+    left = x;
+    right = ++x;
+    while (x < end) {
+        if ((d[x] != s[x]) && !IsSent(sent,page,x)) {
+            right = ++x;
+        } else if (x - right >= SSD1306_DIFFGAP) {
+            break;
+        } else {
+            ++x;
+        }
+    }
+    return true;
+}
+
+/*	DataControl
+ *
+ *		The control byte which starts a transaction of display data
+ */
+
+static const uint8_t DataControl = 0x40;
+
+/*	Continuation control bytes
+ *
+ *		With the Co bit set a control byte applies to the single byte which
+ *	follows it, after which the device expects another control byte. This
+ *	lets commands and data be mixed in one transaction.
+ */
+
+static const uint8_t CommandContinue = 0x80;
+static const uint8_t DataContinue = 0xC0;
+
+/*	WindowCommand
+ *
+ *		Fill in the 7 byte command transaction which sets up a window of pages
+ *	[top,bottom) and columns [left,right).
+ */
+
+static void WindowCommand(uint8_t *buffer, uint8_t top, uint8_t bottom, uint8_t left, uint8_t right)
+{
+	buffer[0] = 0;			/* dc */
+	buffer[1] = SSD1306_SETCOLUMNADDRESS;
+	buffer[2] = left;
+	buffer[3] = right - 1;
+	buffer[4] = SSD1306_SETPAGEADDRESS;
+	buffer[5] = top;
+	buffer[6] = bottom - 1;
+}
+
+/*	WindowSegments
+ *
+ *		Fill in the segments which send a window of the given memory: the data
+ *	control byte, then the slice of each page. Returns the segment count.
+ */
+
+static uint8_t WindowSegments(TWISegment *segment, const uint8_t *memory, uint8_t top, uint8_t bottom, uint8_t left, uint8_t right)
+{
+	uint8_t count = 0;
+	
+	segment[count].data = &DataControl;
+	segment[count++].length = 1;
+	for (uint8_t p = top; p < bottom; ++p) {
+		segment[count].data = memory + left + p * SSD1306_WIDTH;
+		segment[count++].length = right - left;
+	}
+	return count;
+}
+
+/*	SSD1306::writeWindow
+ *
+ *		Write the pages [top,bottom) and columns [left,right) of display memory
+ *	to the device. In horizontal addressing mode the column and page address
+ *	commands set up a window once, and the device wraps from the end of one
+ *	page to the start of the next, so the whole rectangle is streamed as data
+ *	without any further commands. The data is sent as one vectored
+ *	transaction, so nothing is copied. If we are in diff mode the shadow copy
+ *	is updated with the bytes that were sent.
+ */
+
+bool SSD1306::writeWindow(uint8_t top, uint8_t bottom, uint8_t left, uint8_t right)
+{
+	uint8_t buffer[7];
+	TWISegment segment[SSD1306_MAXSEGMENTS];
+	
+	/*
+	 *	Write the preamble
+	 */
+	
+	WindowCommand(buffer,top,bottom,left,right);
+	
+	/* Set window */
+	int8_t err = TWIWrite(address,buffer,7,1);
+	if (err < 0) {
+        return false;
+	}
+	
+	/* Stream the pages straight from display memory */
+	uint8_t count = WindowSegments(segment,display,top,bottom,left,right);
+	err = TWIWritev(address,segment,count,1);
+	if (err < 0) {
+		return false;
+	}
+	
+	if (diffMode) {
+		for (uint8_t p = top; p < bottom; ++p) {
+			uint16_t offset = left + p * SSD1306_WIDTH;
+			memcpy(shadow + offset, display + offset, right - left);
+		}
+	}
+    
+    return true;
+}
+
+/*	WindowCost
+ *
+ *		The number of bytes (including I2C address bytes) needed to write a
+ *	window of the given number of data bytes. Each window costs a 7 byte
+ *	command transaction, followed by one data transaction with a 0x40
+ *	control byte.
+ */
+
+static uint16_t WindowCost(uint16_t bytes)
+{
+    return 8 + 2 + bytes;
+}
+
+/*	StreamWindow
+ *
+ *		Append the commands which set up a window for the run to a stream,
+ *	each with its own continuation control byte. The page is only set if it
+ *	differs from the last run's. Returns the new length of the stream.
+ */
+
+static uint16_t StreamWindow(uint8_t *buffer, uint16_t n, uint8_t &page, uint8_t p, uint8_t left, uint8_t right)
+{
+	if (page != p) {
+		buffer[n++] = CommandContinue;
+		buffer[n++] = SSD1306_SETPAGEADDRESS;
+		buffer[n++] = CommandContinue;
+		buffer[n++] = p;
+		buffer[n++] = CommandContinue;
+		buffer[n++] = p;
+		page = p;
+	}
+	buffer[n++] = CommandContinue;
+	buffer[n++] = SSD1306_SETCOLUMNADDRESS;
+	buffer[n++] = CommandContinue;
+	buffer[n++] = left;
+	buffer[n++] = CommandContinue;
+	buffer[n++] = right - 1;
+	return n;
+}
+
+/*	SSD1306::PlanStream
+ *
+ *		Decide which of the runs to pack into a single stream transaction. The
+ *	longest run ends the stream as plain data; on return last is its index
+ *	and bit i of mask is set for each other run packed ahead of it. Returns
+ *	the bytes (including the I2C address byte) the stream costs, or 0 with
+ *	an empty mask if sending every run as its own window is no more costly.
+ */
+
+uint16_t SSD1306::PlanStream(const Run *run, uint8_t count, uint8_t &last, uint32_t &mask)
+{
+	uint16_t size = 0;
+	uint16_t windows = 0;
+	uint8_t page = 0xFF;
+	
+	mask = 0;
+	last = 0;
+	for (uint8_t i = 1; i < count; ++i) {
+		if (run[i].right - run[i].left > run[last].right - run[last].left) last = i;
+	}
+	
+	for (uint8_t i = 0; i < count; ++i) {
+		if (i == last) continue;
+		
+		uint8_t len = run[i].right - run[i].left;
+		if (len > SSD1306_STREAMRUN) continue;
+		
+		/* Window command, page command if needed, and two bytes per byte */
+		uint16_t n = 6 + 2 * len + ((run[i].page != page) ? 6 : 0);
+		if (size + n + 13 > SSD1306_STREAMBUF) continue;   /* Room for last */
+		
+		size += n;
+		page = run[i].page;
+		windows += WindowCost(len);
+		mask |= 1UL << i;
+	}
+	if (mask == 0) return 0;
+	
+	/* Last window, its data control byte and data, and the address byte */
+	uint8_t len = run[last].right - run[last].left;
+	size += 6 + ((run[last].page != page) ? 6 : 0) + 1 + len + 1;
+	windows += WindowCost(len);
+	
+	if (size >= windows) {
+		mask = 0;
+		return 0;
+	}
+	return size;
+}
+
+/*	SSD1306::writeStream
+ *
+ *		Write the runs planned by PlanStream as a single transaction: each
+ *	packed run as a window command and data, byte by byte with continuation
+ *	control bytes, then the last run's window and its data sent straight
+ *	from display memory. Updates the shadow copy.
+ */
+
+bool SSD1306::writeStream(const Run *run, uint8_t count, uint8_t last, uint32_t mask)
+{
+	uint8_t buffer[SSD1306_STREAMBUF];
+	TWISegment segment[2];
+	uint16_t n = 0;
+	uint8_t page = 0xFF;
+	
+	for (uint8_t i = 0; i < count; ++i) {
+		if (!(mask & (1UL << i))) continue;
+		
+		const uint8_t *d = display + run[i].page * SSD1306_WIDTH;
+		n = StreamWindow(buffer,n,page,run[i].page,run[i].left,run[i].right);
+		for (uint8_t x = run[i].left; x < run[i].right; ++x) {
+			buffer[n++] = DataContinue;
+			buffer[n++] = d[x];
+		}
+	}
+	n = StreamWindow(buffer,n,page,run[last].page,run[last].left,run[last].right);
+	buffer[n++] = DataControl;
+	
+	segment[0].data = buffer;
+	segment[0].length = n;
+	segment[1].data = display + run[last].page * SSD1306_WIDTH + run[last].left;
+	segment[1].length = run[last].right - run[last].left;
+	if (TWIWritev(address,segment,2,1) < 0) return false;
+	
+	for (uint8_t i = 0; i < count; ++i) {
+		if ((i == last) || (mask & (1UL << i))) {
+			uint16_t offset = run[i].left + run[i].page * SSD1306_WIDTH;
+			memcpy(shadow + offset, display + offset, run[i].right - run[i].left);
+		}
+	}
+	return true;
+}
+
+/*	SSD1306::writeRuns
+ *
+ *		Write a set of changed runs, packing short ones into a stream where
+ *	that is cheaper and sending the rest as one page windows.
+ */
+
+bool SSD1306::writeRuns(const Run *run, uint8_t count)
+{
+	uint8_t last;
+	uint32_t mask;
+	
+	if (count == 0) return true;
+	if (PlanStream(run,count,last,mask)) {
+		if (!writeStream(run,count,last,mask)) return false;
+	}
+	
+	for (uint8_t i = 0; i < count; ++i) {
+		if (mask && ((i == last) || (mask & (1UL << i)))) continue;
+		if (!writeWindow(run[i].page,run[i].page+1,run[i].left,run[i].right)) return false;
+	}
+	return true;
+}
+
+/*	SSD1306::writePages
+ *
+ *		Write pages [top,bottom) and columns [left,right) of display memory to
+ *	the device. In diff mode only the runs of bytes which differ from what was
+ *	last sent are written.
+ */
+
+bool SSD1306::writePages(uint8_t top, uint8_t bottom, uint8_t left, uint8_t right, bool diff)
+{
+    if (diff) {
+        Run run[SSD1306_MAXRUNS];
+        uint8_t count = 0;
+        
+        for (uint8_t p = top; p < bottom; ++p) {
+            uint8_t l = left;
+            uint8_t r;
+            while (nextRun(p,l,r,right)) {
+                run[count++] = (Run){ p, l, r };
+                if (count == SSD1306_MAXRUNS) {
+                    if (!writeRuns(run,count)) return false;
+                    count = 0;
+                }
+                l = r;
+            }
+        }
+        return writeRuns(run,count);
+    } else {
+        return writeWindow(top,bottom,left,right);
+    }
+}
+
+/*	SSD1306::writeArea
+ *
+ *		Write pages [top,bottom) and columns [left,right), skipping any pages
+ *	the controller is scrolling
+ */
+
+bool SSD1306::writeArea(uint8_t top, uint8_t bottom, uint8_t left, uint8_t right, bool diff)
+{
+    if (scrolling && (top < scrollBottom) && (bottom > scrollTop)) {
+        if (top < scrollTop) {
+            if (!writePages(top,scrollTop,left,right,diff)) return false;
+        }
+        if (bottom > scrollBottom) {
+            if (!writePages(scrollBottom,bottom,left,right,diff)) return false;
+        }
+        return true;
+    }
+    return writePages(top,bottom,left,right,diff);
+}
+
+/*	SSD1306::writeDisplay
+ *
+ *		Write the display memory to the device, using the cheapest plan: the
+ *	whole display as one window, each of the dirty regions expanded to whole
+ *	pages, or (in diff mode) only the changed runs within them. Pages the
+ *	controller is scrolling are skipped; stopScroll marks them dirty again.
+ */
+
+bool SSD1306::writeDisplay()
+{
+    bool full = false;
+    
+    while (flushing) TWIService();      /* Wait for asynchronous flush */
+    if (flushFailed) {
+        flushFailed = false;
+        shadowValid = false;
+        invalidate();
+    }
+    
+    plan = flushPlan();
+    
+    if (plan.strategy == SSD1306_PLAN_FULL) {
+        full = !scrolling;
+    } else {
+        for (uint8_t i = 0; i < dirtyCount; ++i) {
+            uint8_t top,bottom,left,right;
+            PageBounds(dirty[i],top,bottom,left,right);
+            
+            if (!scrolling && (top == 0) && (bottom == SSD1306_NUMPAGES) && (left == 0) && (right == SSD1306_WIDTH)) {
+                full = true;
+            }
+        }
+    }
+    
+    /*
+     *  Send the pages in priority order. A full plan sends the normal and
+     *  low priority pages together as one window, after the higher
+     *  priority pages (planCost counts both).
+     */
+    
+    bool diff = (plan.strategy == SSD1306_PLAN_DIFF) || ((plan.strategy == SSD1306_PLAN_FULL) && diffMode && shadowValid);
+    uint8_t c = SSD1306_PRIORITIES;
+    while (c-- > 0) {
+        if ((c <= SSD1306_PRIORITY_NORMAL) && (plan.strategy == SSD1306_PLAN_FULL)) {
+            if (!writeArea(0,SSD1306_NUMPAGES,0,SSD1306_WIDTH,false)) return false;
+            break;
+        }
+        if (!writeClass(c,diff)) return false;
+    }
+    
+    /*
+     *  Once the entire display has been sent the shadow matches the device.
+     *  That includes the case where steps sent part of it.
+     */
+    
+    if (shadowFilling && !scrolling) full = true;
+    shadowFilling = false;
+    if (diffMode && full) shadowValid = true;
+	
+	validate();
+    
+    for (c = 0; c < SSD1306_PRIORITIES; ++c) {
+        if (latencyPending & (1 << c)) flushed(c);
+    }
+    
+    return true;
+}
+
+/*	SSD1306::writeDisplayStep
+ *
+ *		Send part of the dirty regions. We repeatedly take the highest
+ *	priority run of pages in the dirty regions, send as many of them as fit
+ *	within maxBytes (in diff mode only their changed runs) and then drop
+ *	those pages from their region. At least one page is sent, so each call
+ *	makes progress. Since the regions themselves record what is left,
+ *	drawing between steps just adds to them.
+ *
+ *		Diff mode needs the whole display sent once before the shadow can be
+ *	trusted. If it is not valid we note when everything is dirty, and once
+ *	the steps have emptied the dirty list it is.
+ */
+
+bool SSD1306::writeDisplayStep(uint16_t maxBytes)
+{
+    return writeSteps(maxBytes,0xFFFFFFFF);
+}
+
+/*	SSD1306::writeSteps
+ *
+ *		Do the work of writeDisplayStep, sending pages while both the bytes
+ *	and the predicted time (as PlanTime works it out, so including
+ *	SSD1306_TXNTIME for each transaction) fit within the limits.
+ */
+
+bool SSD1306::writeSteps(uint16_t maxBytes, uint32_t maxMicros)
+{
+    SSD1306Plan p;
+    bool diff;
+    
+    if (flushing) {
+        TWIService();
+        return true;
+    }
+    if (flushFailed) {
+        flushFailed = false;
+        shadowValid = false;
+        shadowFilling = false;
+        invalidate();
+    }
+    
+    if (scrolling) {
+        shadowFilling = false;
+    } else if (diffMode && !shadowValid && !shadowFilling) {
+        for (uint8_t i = 0; i < dirtyCount; ++i) {
+            uint8_t top,bottom,left,right;
+            PageBounds(dirty[i],top,bottom,left,right);
+            if ((top == 0) && (bottom == SSD1306_NUMPAGES) && (left == 0) && (right == SSD1306_WIDTH)) {
+                shadowFilling = true;
+            }
+        }
+    }
+    diff = diffMode && shadowValid;
+    
+    memset(&p,0,sizeof(p));
+    p.strategy = diff ? SSD1306_PLAN_DIFF : SSD1306_PLAN_WINDOWS;
+    
+    while (dirtyCount > 0) {
+        uint8_t top,bottom,left,right;
+        
+        /*
+         *  Find the first run of pages in the highest priority class
+         */
+        
+        uint8_t best = 0xFF;
+        uint8_t bestClass = 0;
+        uint8_t bandTop = 0;
+        uint8_t bandBottom = 0;
+        
+        for (uint8_t i = 0; i < dirtyCount; ) {
+            if ((dirty[i].size.width == 0) || (dirty[i].size.height == 0)) {
+                dirty[i] = dirty[--dirtyCount];
+                continue;
+            }
+            
+            PageBounds(dirty[i],top,bottom,left,right);
+            for (uint8_t pg = top; pg < bottom; ++pg) {
+                uint8_t c = pageClass(pg,left,right);
+                if ((best == 0xFF) || (c > bestClass)) {
+                    best = i;
+                    bestClass = c;
+                    bandTop = pg;
+                    bandBottom = pg + 1;
+                    while ((bandBottom < bottom) && (pageClass(bandBottom,left,right) == c)) ++bandBottom;
+                }
+            }
+            ++i;
+        }
+        if (best == 0xFF) break;
+        
+        /*
+         *  Sending pages from the middle of a region splits it in two. If
+         *  there is no room for another region, send from its top instead.
+         */
+        
+        PageBounds(dirty[best],top,bottom,left,right);
+        if ((bandTop > top) && (dirtyCount >= GD_MAXDIRTY)) bandTop = top;
+        
+        /*
+         *  Find how many pages fit
+         */
+        
+        SSD1306Plan cost;
+        uint8_t end = bandTop;
+        memset(&cost,0,sizeof(cost));
+        while (end < bandBottom) {
+            SSD1306Plan c;
+            memset(&c,0,sizeof(c));
+            areaCost(c,bandTop,end+1,left,right,diff);
+            c.bytes += p.bytes;
+            c.transactions += p.transactions;
+            PlanTime(c);
+            if (((c.bytes > maxBytes) || (c.micros > maxMicros)) && ((p.bytes > 0) || (end > bandTop))) break;
+            cost = c;
+            ++end;
+        }
+        if (end == bandTop) break;
+        
+        if (!writeArea(bandTop,end,left,right,diff)) return false;
+        p.bytes = cost.bytes;
+        p.transactions = cost.transactions;
+        p.micros = cost.micros;
+        
+        removePages(best,bandTop,end);
+        if ((p.bytes >= maxBytes) || (p.micros >= maxMicros)) break;
+    }
+    
+    for (uint8_t c = 0; c < SSD1306_PRIORITIES; ++c) {
+        if ((latencyPending & (1 << c)) && !classDirty(c)) flushed(c);
+    }
+    
+    if (dirtyCount == 0) {
+        if (shadowFilling && diffMode) shadowValid = true;
+        shadowFilling = false;
+    }
+    
+    PlanTime(p);
+    plan = p;
+    return true;
+}
+
+/*	SSD1306::writeDisplayFor
+ *
+ *		Send the dirty regions until they are all sent or the deadline (in
+ *	GetMilliseconds time) passes. Each step is sized so its predicted time
+ *	fits in the time left, so we don't run far past it.
+ */
+
+bool SSD1306::writeDisplayFor(uint32_t deadline)
+{
+    while ((dirtyCount > 0) && !flushing) {
+        int32_t ms = (int32_t)(deadline - GetMilliseconds());
+        if (ms <= 0) break;
+        
+        if (ms > 60000) ms = 60000;
+        if (!writeSteps(0xFFFF,ms * 1000UL)) return false;
+    }
+    return true;
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Priorities  															*/
+/*																			*/
+/****************************************************************************/
+
+/*	SSD1306::setPriority
+ *
+ *		Give an area of the display a priority class
+ */
+
+bool SSD1306::setPriority(GDRect r, uint8_t priority)
+{
+    if ((areaCount >= SSD1306_MAXAREAS) || (priority >= SSD1306_PRIORITIES)) return false;
+    if ((r.size.width == 0) || (r.size.height == 0)) return false;
+    
+    PriorityArea &a = area[areaCount++];
+    PageBounds(r,a.top,a.bottom,a.left,a.right);
+    a.priority = priority;
+    return true;
+}
+
+/*	SSD1306::clearPriorities
+ *
+ *		Remove all priority areas
+ */
+
+void SSD1306::clearPriorities()
+{
+    areaCount = 0;
+}
+
+/*	SSD1306::clearLatency
+ *
+ *		Reset the latency statistics
+ */
+
+void SSD1306::clearLatency()
+{
+    memset(latencyStats,0,sizeof(latencyStats));
+}
+
+/*	SSD1306::pageClass
+ *
+ *		The priority class of the columns [left,right) of a page: the highest
+ *	priority of the areas they overlap, or normal if they are not all within
+ *	a single area.
+ */
+
+uint8_t SSD1306::pageClass(uint8_t page, uint8_t left, uint8_t right)
+{
+    uint8_t c = SSD1306_PRIORITY_LOW;
+    bool covered = false;
+    
+    for (uint8_t i = 0; i < areaCount; ++i) {
+        const PriorityArea &a = area[i];
+        if ((page < a.top) || (page >= a.bottom) || (right <= a.left) || (left >= a.right)) continue;
+        
+        if (a.priority > c) c = a.priority;
+        if ((a.left <= left) && (a.right >= right)) covered = true;
+    }
+    
+    if (!covered && (c < SSD1306_PRIORITY_NORMAL)) c = SSD1306_PRIORITY_NORMAL;
+    return c;
+}
+
+/*	SSD1306::classDirty
+ *
+ *		Returns true if any dirty page is in the priority class
+ */
+
+bool SSD1306::classDirty(uint8_t priority)
+{
+    for (uint8_t i = 0; i < dirtyCount; ++i) {
+        if ((dirty[i].size.width == 0) || (dirty[i].size.height == 0)) continue;
+        
+        uint8_t top,bottom,left,right;
+        PageBounds(dirty[i],top,bottom,left,right);
+        for (uint8_t p = top; p < bottom; ++p) {
+            if (pageClass(p,left,right) == priority) return true;
+        }
+    }
+    return false;
+}
+
+/*	SSD1306::writeClass
+ *
+ *		Write the pages of the dirty regions in the priority class. The dirty
+ *	regions are left alone.
+ */
+
+bool SSD1306::writeClass(uint8_t priority, bool diff)
+{
+    for (uint8_t i = 0; i < dirtyCount; ++i) {
+        if ((dirty[i].size.width == 0) || (dirty[i].size.height == 0)) continue;
+        
+        uint8_t top,bottom,left,right;
+        PageBounds(dirty[i],top,bottom,left,right);
+        
+        uint8_t p = top;
+        while (p < bottom) {
+            if (pageClass(p,left,right) != priority) {
+                ++p;
+                continue;
+            }
+            
+            uint8_t end = p + 1;
+            while ((end < bottom) && (pageClass(end,left,right) == priority)) ++end;
+            if (!writeArea(p,end,left,right,diff)) return false;
+            p = end;
+        }
+    }
+    return true;
+}
+
+/*	SSD1306::removePages
+ *
+ *		Remove the pages [top,bottom) from dirty region i. Removing pages from
+ *	the middle of a region splits it, and the caller must make sure there is
+ *	room for the extra region.
+ */
+
+void SSD1306::removePages(uint8_t i, uint8_t top, uint8_t bottom)
+{
+    GDRect &r = dirty[i];
+    uint8_t y0 = r.origin.y;
+    uint8_t y1 = r.origin.y + r.size.height;
+    uint8_t ya = top * 8;
+    uint8_t yb = bottom * 8;
+    
+    if ((ya <= y0) && (yb >= y1)) {
+        dirty[i] = dirty[--dirtyCount];
+    } else if (ya <= y0) {
+        r.origin.y = yb;
+        r.size.height = y1 - yb;
+    } else if (yb >= y1) {
+        r.size.height = ya - y0;
+    } else {
+        GDRect below = r;
+        below.origin.y = yb;
+        below.size.height = y1 - yb;
+        r.size.height = ya - y0;
+        dirty[dirtyCount++] = below;
+    }
+}
+
+/*	SSD1306::dirtyInternal
+ *
+ *		Note the time of the first change in each priority class since it
+ *	was last sent
+ */
+
+void SSD1306::dirtyInternal(const GDRect &r)
+{
+    uint8_t top,bottom,left,right;
+    PageBounds(r,top,bottom,left,right);
+    
+    for (uint8_t p = top; p < bottom; ++p) {
+        uint8_t c = pageClass(p,left,right);
+        if (!(latencyPending & (1 << c))) {
+            latencyPending |= 1 << c;
+            latencySince[c] = GetMilliseconds();
+        }
+    }
+}
+
+/*	SSD1306::flushed
+ *
+ *		Record the latency of a priority class whose changes have all been
+ *	sent
+ */
+
+void SSD1306::flushed(uint8_t priority)
+{
+    SSD1306Latency &l = latencyStats[priority];
+    uint32_t t = GetMilliseconds() - latencySince[priority];
+    
+    ++l.count;
+    l.total += t;
+    l.last = t;
+    if (l.max < t) l.max = t;
+    
+    latencyPending &= ~(1 << priority);
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Double Buffering														*/
+/*																			*/
+/****************************************************************************/
+
+/*	SSD1306::swap
+ *
+ *		Copy the dirty pages of display memory into the front buffer and start
+ *	sending them from the I2C interrupt, higher priority regions first. Each
+ *	dirty region is sent as a whole window (in diff mode the shadow is updated
+ *	as if it had been sent, since runs would need more windows than we can
+ *	queue). Returns false without doing anything if the previous flush has
+ *	not finished.
+ */
+
+bool SSD1306::swap()
+{
+    if (flushing) return false;
+    
+    /*
+     *  If the last flush failed we no longer know what the device holds
+     */
+    
+    if (flushFailed) {
+        flushFailed = false;
+        shadowValid = false;
+        invalidate();
+    }
+    
+    bool full = false;
+    flushCount = 0;
+    for (uint8_t i = 0; i < dirtyCount; ++i) {
+        if ((dirty[i].size.width == 0) || (dirty[i].size.height == 0)) continue;
+        
+        uint8_t top,bottom,left,right;
+        PageBounds(dirty[i],top,bottom,left,right);
+        
+        if (scrolling && (top < scrollBottom) && (bottom > scrollTop)) {
+            if (top < scrollTop) {
+                flushWindow[flushCount++] = (FlushWindow){ top, scrollTop, left, right };
+            }
+            if (bottom > scrollBottom) {
+                flushWindow[flushCount++] = (FlushWindow){ scrollBottom, bottom, left, right };
+            }
+            continue;
+        }
+        
+        if ((top == 0) && (bottom == SSD1306_NUMPAGES) && (left == 0) && (right == SSD1306_WIDTH)) {
+            full = true;
+        }
+        flushWindow[flushCount++] = (FlushWindow){ top, bottom, left, right };
+    }
+    
+    /*
+     *  Send the windows in priority order, by the highest class each holds
+     */
+    
+    uint8_t windowClass[SSD1306_MAXWINDOWS];
+    for (uint8_t i = 0; i < flushCount; ++i) {
+        const FlushWindow &w = flushWindow[i];
+        windowClass[i] = SSD1306_PRIORITY_LOW;
+        for (uint8_t p = w.top; p < w.bottom; ++p) {
+            uint8_t c = pageClass(p,w.left,w.right);
+            if (windowClass[i] < c) windowClass[i] = c;
+        }
+        
+        for (uint8_t j = i; (j > 0) && (windowClass[j-1] < windowClass[j]); --j) {
+            FlushWindow tw = flushWindow[j];
+            flushWindow[j] = flushWindow[j-1];
+            flushWindow[j-1] = tw;
+            uint8_t tc = windowClass[j];
+            windowClass[j] = windowClass[j-1];
+            windowClass[j-1] = tc;
+        }
+    }
+    
+    /*
+     *  Copy the windows into the front buffer
+     */
+    
+    for (uint8_t i = 0; i < flushCount; ++i) {
+        const FlushWindow &w = flushWindow[i];
+        for (uint8_t p = w.top; p < w.bottom; ++p) {
+            uint16_t offset = w.left + p * SSD1306_WIDTH;
+            memcpy(front + offset, display + offset, w.right - w.left);
+            if (diffMode) {
+                memcpy(shadow + offset, display + offset, w.right - w.left);
+            }
+        }
+    }
+    if (shadowFilling && !scrolling) full = true;
+    shadowFilling = false;
+    if (diffMode && full) shadowValid = true;
+    
+    validate();
+    
+    /*
+     *  Latency is measured to when the changes are queued
+     */
+    
+    for (uint8_t c = 0; c < SSD1306_PRIORITIES; ++c) {
+        if (latencyPending & (1 << c)) flushed(c);
+    }
+    
+    /*
+     *  Start sending
+     */
+    
+    if (flushCount == 0) return true;
+    
+    flushIndex = 0;
+    flushing = true;
+    if (!flushNext()) {
+        flushing = false;
+        flushFailed = true;
+    }
+    return true;
+}
+
+/*	SSD1306::flushNext
+ *
+ *		Queue the next window of the flush: the window command, then its data
+ *	as a single vectored write from the front buffer, whose completion calls
+ *	us again. Clears flushing once everything is sent. Returns false if the
+ *	transfers could not be queued.
+ */
+
+bool SSD1306::flushNext()
+{
+    if (flushIndex >= flushCount) {
+        flushing = false;
+        return true;
+    }
+    
+    const FlushWindow &w = flushWindow[flushIndex++];
+    WindowCommand(flushCommand,w.top,w.bottom,w.left,w.right);
+    uint8_t count = WindowSegments(flushSegment,front,w.top,w.bottom,w.left,w.right);
+    
+    if (TWIWriteAsync(address,flushCommand,7,1,NULL,NULL) < 0) return false;
+    return TWIEnqueuev(address,flushSegment,count,TWI_FLAG_STOP,FlushCallback,this) >= 0;
+}
+
+/*	SSD1306::FlushCallback
+ *
+ *		Called from the I2C interrupt as each transfer of a flush completes.
+ *	Chains the next transfer, or abandons the flush on error.
+ */
+
+void SSD1306::FlushCallback(int8_t status, void *context)
+{
+    SSD1306 *d = (SSD1306 *)context;
+    
+    if ((status < 0) || !d->flushNext()) {
+        d->flushFailed = true;
+        d->flushing = false;
+    }
+}
+
+/*	SSD1306::pagesCost
+ *
+ *		Add the bytes and transactions writePages would send for the given
+ *	pages to the plan. In diff mode, if sent is not NULL, bytes marked in it
+ *	count as unchanged and the runs are marked in it.
+ */
+
+void SSD1306::pagesCost(SSD1306Plan &p, uint8_t top, uint8_t bottom, uint8_t left, uint8_t right, bool diff, uint8_t *sent)
+{
+    if (diff) {
+        Run run[SSD1306_MAXRUNS];
+        uint8_t count = 0;
+        
+        for (uint8_t pg = top; pg < bottom; ++pg) {
+            uint8_t l = left;
+            uint8_t r;
+            while (nextRun(pg,l,r,right,sent)) {
+                if (sent) MarkSent(sent,pg,l,r);
+                run[count++] = (Run){ pg, l, r };
+                if (count == SSD1306_MAXRUNS) {
+                    runsCost(p,run,count);
+                    count = 0;
+                }
+                l = r;
+            }
+        }
+        runsCost(p,run,count);
+    } else {
+        p.bytes += WindowCost((bottom - top) * (uint16_t)(right - left));
+        p.transactions += 2;
+    }
+}
+
+/*	SSD1306::runsCost
+ *
+ *		Add the bytes and transactions writeRuns would send for the runs to
+ *	the plan
+ */
+
+void SSD1306::runsCost(SSD1306Plan &p, const Run *run, uint8_t count)
+{
+    uint8_t last;
+    uint32_t mask;
+    uint16_t stream;
+    
+    if (count == 0) return;
+    stream = PlanStream(run,count,last,mask);
+    if (stream) {
+        p.bytes += stream;
+        p.transactions += 1;
+    }
+    
+    for (uint8_t i = 0; i < count; ++i) {
+        if (mask && ((i == last) || (mask & (1UL << i)))) continue;
+        p.bytes += WindowCost(run[i].right - run[i].left);
+        p.transactions += 2;
+    }
+}
+
+/*	SSD1306::areaCost
+ *
+ *		Add the cost of writeArea to the plan
+ */
+
+void SSD1306::areaCost(SSD1306Plan &p, uint8_t top, uint8_t bottom, uint8_t left, uint8_t right, bool diff, uint8_t *sent)
+{
+    if (scrolling && (top < scrollBottom) && (bottom > scrollTop)) {
+        if (top < scrollTop) pagesCost(p,top,scrollTop,left,right,diff,sent);
+        if (bottom > scrollBottom) pagesCost(p,scrollBottom,bottom,left,right,diff,sent);
+    } else {
+        pagesCost(p,top,bottom,left,right,diff,sent);
+    }
+}
+
+/*	SSD1306::classCost
+ *
+ *		Add the cost of writeClass to the plan
+ */
+
+void SSD1306::classCost(SSD1306Plan &p, uint8_t priority, bool diff, uint8_t *sent)
+{
+    for (uint8_t i = 0; i < dirtyCount; ++i) {
+        if ((dirty[i].size.width == 0) || (dirty[i].size.height == 0)) continue;
+        
+        uint8_t top,bottom,left,right;
+        PageBounds(dirty[i],top,bottom,left,right);
+        
+        uint8_t pg = top;
+        while (pg < bottom) {
+            if (pageClass(pg,left,right) != priority) {
+                ++pg;
+                continue;
+            }
+            
+            uint8_t end = pg + 1;
+            while ((end < bottom) && (pageClass(end,left,right) == priority)) ++end;
+            areaCost(p,pg,end,left,right,diff,sent);
+            pg = end;
+        }
+    }
+}
+
+/*	SSD1306::planCost
+ *
+ *		Work out the cost of flushing the dirty regions with the given
+ *	strategy. The time is 9 bit times per byte plus a start and a stop per
+ *	transaction at the current bus frequency, and SSD1306_TXNTIME for each
+ *	transaction.
+ *
+ *		The regions are costed in the order writeDisplay sends them. In diff
+ *	mode, once one region's runs are sent a later region sharing those pages
+ *	finds them unchanged, so we track the bytes sent in a bitmap rather
+ *	than count them twice. A full plan still sends the pages above normal
+ *	priority first, so their cost is added to the window.
+ */
+
+void SSD1306::planCost(SSD1306Plan &p, uint8_t strategy)
+{
+    uint8_t sent[SSD1306_MEMORY / 8];
+    uint8_t c = SSD1306_PRIORITIES;
+    
+    p.strategy = strategy;
+    p.bytes = 0;
+    p.transactions = 0;
+    memset(sent,0,sizeof(sent));
+    
+    if (strategy == SSD1306_PLAN_FULL) {
+        while (c-- > SSD1306_PRIORITY_NORMAL + 1) {
+            classCost(p,c,diffMode && shadowValid,sent);
+        }
+        areaCost(p,0,SSD1306_NUMPAGES,0,SSD1306_WIDTH,false);
+    } else {
+        while (c-- > 0) {
+            classCost(p,c,strategy == SSD1306_PLAN_DIFF,sent);
+        }
+    }
+    
+    PlanTime(p);
+}
+
+/*	SSD1306::PlanTime
+ *
+ *		Fill in the predicted time of a plan from its bytes and transactions
+ */
+
+void SSD1306::PlanTime(SSD1306Plan &p)
+{
+    uint32_t freq = TWIGetFrequency();
+    uint32_t bits = p.bytes * 9UL + p.transactions * 2UL;
+    if (freq < 1000) freq = TWI_FREQ;
+    
+    p.micros = (bits * 1000) / (freq / 1000) + p.transactions * (uint32_t)SSD1306_TXNTIME;
+}
+
+/*	SSD1306::flushPlan
+ *
+ *		Choose how writeDisplay should send the current dirty regions: the
+ *	candidate predicted to take the least time on the bus. Diff is only a
+ *	candidate while the shadow copy is valid.
+ */
+
+SSD1306Plan SSD1306::flushPlan()
+{
+    SSD1306Plan best;
+    SSD1306Plan p;
+    
+    if (diffMode && shadowValid) {
+        planCost(best,SSD1306_PLAN_DIFF);
+        planCost(p,SSD1306_PLAN_WINDOWS);
+        if (p.micros < best.micros) best = p;
+    } else {
+        planCost(best,SSD1306_PLAN_WINDOWS);
+    }
+    
+    if (dirtyCount > 0) {
+        planCost(p,SSD1306_PLAN_FULL);
+        if (p.micros < best.micros) best = p;
+    }
+    return best;
+}
+
+/*	SSD1306::dirtyCost
+ *
+ *		Returns the number of bytes (including I2C address bytes) that would
+ *	be sent over the bus by writeDisplay for the current dirty regions.
  */
 
-void SSD1306::clear()
+uint16_t SSD1306::dirtyCost()
 {
-	memset(display,0,SSD1306_MEMORY);
-	invalidate();
+    return flushPlan().bytes;
 }
 
-/*	SSD1306::writeDisplay
+
+/****************************************************************************/
+/*																			*/
+/*	Raster Operations														*/
+/*																			*/
+/****************************************************************************/
+
+/*
+ *	Each drawing mode is a policy class which applies a bit pattern to a byte
+ *	of display memory. The drawing primitives below are templates on the
+ *	policy, and the drawing mode is resolved once per primitive rather than
+ *	once per byte touched. Modes which set a full byte to a constant value
+ *	note so in 'solid', so full pages can be filled with memset.
+ */
+
+struct RopBlack {
+	enum { solid = 1, fill = 0x00 };
+	static inline void apply(uint8_t &d, uint8_t pattern)
+	{
+		d &= ~pattern;
+	}
+};
+
+struct RopWhite {
+	enum { solid = 1, fill = 0xFF };
+	static inline void apply(uint8_t &d, uint8_t pattern)
+	{
+		d |= pattern;
+	}
+};
+
+struct RopXor {
+	enum { solid = 0, fill = 0x00 };
+	static inline void apply(uint8_t &d, uint8_t pattern)
+	{
+		d ^= pattern;
+	}
+};
+
+/*	VBar
  *
- *		Write the display memory to the device. This writes in the dirty rectangle
- *	provided. Note right and bottom is equal to the pixel position of the right hand
- *	side, so one pixel would be (0,0)-(0,0)
+ *		Draw a vertical bar from top to bottom inclusive into column x
  */
 
-bool SSD1306::writeDisplay()
+template <class Op>
+static void VBar(uint8_t *display, uint8_t x, uint8_t top, uint8_t bottom)
 {
-	uint8_t buffer[32];
-	uint8_t pos;
+	uint8_t pageTop = (SSD1306_NUMPAGES-1) & (top >> 3);
+	uint8_t pageBottom = (SSD1306_NUMPAGES-1) & (bottom >> 3);
 	
-	/*
-	 *	If size is zero, return
-	 */
+	uint8_t topPattern = 0xFF << (top & 0x07);
+	uint8_t bottomPattern = (0x02 << (bottom & 0x07)) - 1;
 	
-	if ((dirty.size.width == 0) || (dirty.size.height == 0)) {
-		validate();
-		return true;
+	uint8_t *ptr = display + x + pageTop * SSD1306_WIDTH;
+	if (pageTop == pageBottom) {
+		Op::apply(*ptr, topPattern & bottomPattern);
+	} else {
+		Op::apply(*ptr, topPattern);
+		for (uint8_t i = pageTop + 1; i < pageBottom; ++i) {
+			ptr += SSD1306_WIDTH;
+			Op::apply(*ptr, 0xFF);
+		}
+		Op::apply(display[x + pageBottom * SSD1306_WIDTH], bottomPattern);
 	}
+}
+
+/*	HBar
+ *
+ *		Draw a horizontal bar from left to right inclusive on row y
+ */
+
+template <class Op>
+static void HBar(uint8_t *display, uint8_t left, uint8_t right, uint8_t y)
+{
+	uint8_t bit = 1 << (0x07 & y);
+	uint8_t page = (SSD1306_NUMPAGES-1) & (y >> 3);
 	
-	/*
-	 *	Write the preamble
-	 */
+	uint8_t *ptr = display + left + page * SSD1306_WIDTH;
+	uint8_t i = left;
+	do {
+		Op::apply(*ptr++, bit);
+	} while (i++ < right);
+}
+
+/****************************************************************************/
+/*																			*/
+/*	SSD1306 Drawing Support													*/
+/*																			*/
+/****************************************************************************/
+
+/*	FillRect
+ *
+ *		Fill a rectangle, right and bottom inclusive. The top and bottom masks
+ *	are worked out once, and each page is then filled in a single pass.
+ */
+
+template <class Op>
+static void FillRect(uint8_t *display, uint8_t left, uint8_t top, uint8_t right, uint8_t bottom)
+{
+	uint8_t pageTop = top >> 3;
+	uint8_t pageBottom = bottom >> 3;
+	uint8_t width = right - left + 1;
 	
-	uint8_t top = dirty.origin.y / 8;
-	uint8_t bottom = 1 + (dirty.origin.y + dirty.size.height) / 8;
-	if (bottom > SSD1306_NUMPAGES) {
-		bottom = SSD1306_NUMPAGES;
-	}
-	uint8_t left = dirty.origin.x;
-	uint8_t right = dirty.origin.x + dirty.size.width;
-	if (right > SSD1306_WIDTH) {
-		right = SSD1306_WIDTH;
-	}
+	uint8_t topPattern = 0xFF << (top & 0x07);
+	uint8_t bottomPattern = (0x02 << (bottom & 0x07)) - 1;
+	if (pageTop == pageBottom) topPattern &= bottomPattern;
 	
-	for (uint8_t p = top; p < bottom; ++p) {
-		buffer[0] = 0;			/* dc */
-		buffer[1] = SSD1306_SETPAGESTART | (p);
-		buffer[2] = SSD1306_SETHIGHCOLUMN | ((left) >> 4);
-		buffer[3] = SSD1306_SETLOWCOLUMN | (0x0F & (left));
+	uint8_t *ptr = display + left + pageTop * SSD1306_WIDTH;
+	for (uint8_t p = pageTop; p <= pageBottom; ++p, ptr += SSD1306_WIDTH) {
+		uint8_t pattern = 0xFF;
+		if (p == pageTop) {
+			pattern = topPattern;
+		} else if (p == pageBottom) {
+			pattern = bottomPattern;
+		}
 		
-		/* Set start position */
-		int8_t err = TWIWrite(address,buffer,4,1);
-		if (err < 0) {
-            return false;
+		if (Op::solid && (pattern == 0xFF)) {
+			memset(ptr, Op::fill, width);
+		} else {
+			uint8_t *end = ptr + width;
+			for (uint8_t *q = ptr; q < end; ++q) {
+				Op::apply(*q, pattern);
+			}
 		}
+	}
+}
+
+/*	BlitPages
+ *
+ *		Combine a block of page organized data (each byte a vertical run of 8
+ *	pixels, LSB at the top, rows of width bytes) into display memory with the
+ *	upper left corner at (x,y). When y is not page aligned each source byte is
+ *	split across two display pages. Anything off the display is dropped.
+ */
+
+template <class Op>
+static void BlitPages(uint8_t *display, const uint8_t *data, uint8_t width, uint8_t pages, uint8_t x, uint8_t y)
+{
+	uint8_t shift = y & 0x07;
+	uint8_t page = y >> 3;
+	uint8_t stride = width;				/* Source row length, unclipped */
+	
+	if (x >= SSD1306_WIDTH) return;
+	if (width > SSD1306_WIDTH - x) width = SSD1306_WIDTH - x;
+	
+	for (uint8_t p = 0; p < pages; ++p, ++page) {
+		const uint8_t *row = data + p * (uint16_t)stride;
+		uint8_t *lo = (page < SSD1306_NUMPAGES) ? display + x + page * SSD1306_WIDTH : NULL;
+		uint8_t *hi = ((shift != 0) && (page + 1 < SSD1306_NUMPAGES)) ? display + x + (page + 1) * SSD1306_WIDTH : NULL;
 		
-		/* Run the rows */
-		pos = 0;
-		uint8_t *ptr = display + left + p * SSD1306_WIDTH;
-		for (uint8_t x = left; x < right; ++x) {
-			if (pos == 0) {
-				buffer[pos++] = 0x40;
+		if (lo == NULL && hi == NULL) continue;
+		
+		if (shift == 0) {
+			for (uint8_t c = 0; c < width; ++c) {
+				Op::apply(lo[c], row[c]);
 			}
-			buffer[pos++] = *ptr++;
-			if (pos >= sizeof(buffer)) {
-				int8_t err = TWIWrite(address, buffer, pos, 1);
-                if (err < 0) {
-                    return false;
-                }
-				pos = 0;
+		} else {
+			for (uint8_t c = 0; c < width; ++c) {
+				uint8_t b = row[c];
+				if (lo) Op::apply(lo[c], b << shift);
+				if (hi) Op::apply(hi[c], b >> (8 - shift));
 			}
 		}
+	}
+}
+
+/*
+ *	Bitmap raster operations. These combine a byte of source pixels into a
+ *	byte of display memory, changing only the bits set in the mask.
+ */
+
+struct BltCopy {
+	static inline void apply(uint8_t &d, uint8_t s, uint8_t m)
+	{
+		d = (d & ~m) | (s & m);
+	}
+};
+
+struct BltOr {
+	static inline void apply(uint8_t &d, uint8_t s, uint8_t m)
+	{
+		d |= s & m;
+	}
+};
+
+struct BltAnd {
+	static inline void apply(uint8_t &d, uint8_t s, uint8_t m)
+	{
+		d &= s | ~m;
+	}
+};
+
+struct BltXor {
+	static inline void apply(uint8_t &d, uint8_t s, uint8_t m)
+	{
+		d ^= s & m;
+	}
+};
+
+/*	BitmapColumn
+ *
+ *		Return the 8 pixels of column x of the bitmap starting at row y as a
+ *	page byte, LSB at the top. Rows past the bottom of the bitmap read as
+ *	zero. Page organized bitmaps are read a byte (or two when y is not a
+ *	multiple of 8) at a time.
+ */
+
+static uint8_t BitmapColumn(const GDBitmap *b, uint8_t x, uint8_t y)
+{
+	uint8_t ret = 0;
+	
+	if (b->format == GD_BITMAP_PAGE) {
+		uint8_t page = y >> 3;
+		uint8_t shift = y & 0x07;
+		const uint8_t *ptr = b->data + page * (uint16_t)b->width + x;
+		
+		ret = *ptr >> shift;
+		if ((shift != 0) && ((page + 1) * 8 < b->height)) {
+			ret |= ptr[b->width] << (8 - shift);
+		}
+	} else {
+		uint8_t stride = (b->width + 7) >> 3;
+		uint8_t bit = (b->format == GD_BITMAP_LSB) ? (0x01 << (x & 7)) : (0x80 >> (x & 7));
+		const uint8_t *ptr = b->data + y * (uint16_t)stride + (x >> 3);
 		
-		if (pos > 0) {
-			int8_t err = TWIWrite(address, buffer, pos, 1);
-            if (err < 0) {
-                return false;
-            }
+		uint8_t rows = b->height - y;
+		if (rows > 8) rows = 8;
+		for (uint8_t i = 0; i < rows; ++i, ptr += stride) {
+			if (*ptr & bit) ret |= 1 << i;
 		}
 	}
-	
-	validate();
-    
-    return true;
+	return ret;
 }
 
+/*	DrawBitmap
+ *
+ *		Combine the src area of a bitmap into display memory with its upper left
+ *	corner at (x,y). This walks the display a page at a time: for each page we
+ *	work out which bits are covered by the bitmap, and fetch each column of
+ *	source pixels as a byte lined up with the page.
+ */
 
-/****************************************************************************/
-/*																			*/
-/*	SSD1306 Drawing Support													*/
-/*																			*/
-/****************************************************************************/
+template <class Op>
+static void DrawBitmap(uint8_t *display, uint8_t x, uint8_t y, const GDBitmap *bitmap, const GDBitmap *mask, GDRect src)
+{
+	uint8_t bottom = y + src.size.height - 1;
+	uint8_t pageTop = y >> 3;
+	uint8_t pageBottom = bottom >> 3;
+	
+	for (uint8_t p = pageTop; p <= pageBottom; ++p) {
+		uint8_t edge = 0xFF;
+		if (p == pageTop) edge &= 0xFF << (y & 0x07);
+		if (p == pageBottom) edge &= (0x02 << (bottom & 0x07)) - 1;
+		
+		/*
+		 *	Source row lined up with the top of this page. On the first page
+		 *	this is above the source, so we shift the column down instead.
+		 */
+		
+		int16_t row = src.origin.y + (int16_t)(p * 8) - y;
+		uint8_t shift = 0;
+		if (row < 0) {
+			shift = -row;
+			row = 0;
+		}
+		
+		uint8_t *ptr = display + x + p * SSD1306_WIDTH;
+		for (uint8_t i = 0; i < src.size.width; ++i) {
+			uint8_t sx = src.origin.x + i;
+			uint8_t s = BitmapColumn(bitmap,sx,row) << shift;
+			uint8_t m = edge;
+			if (mask) m &= BitmapColumn(mask,sx,row) << shift;
+			Op::apply(ptr[i],s,m);
+		}
+	}
+}
 
 /*	SSD1306::setPixel
  *
@@ -296,17 +1825,17 @@ void SSD1306::setPixelInternal(uint8_t x, uint8_t y)
 	uint8_t bit = 1 << (0x07 & y);
 	uint8_t page = (SSD1306_NUMPAGES-1) & (y >> 3);
 	
-	uint16_t offset = x + page * (uint16_t)SSD1306_WIDTH;
+	uint8_t &d = display[x + page * (uint16_t)SSD1306_WIDTH];
 	switch (mode) {
 		case GL_BLACK:
-			display[offset] &= ~bit;
+			RopBlack::apply(d, bit);
 			break;
 		default:
 		case GL_WHITE:
-			display[offset] |= bit;
+			RopWhite::apply(d, bit);
 			break;
 		case GL_XOR:
-			display[offset] ^= bit;
+			RopXor::apply(d, bit);
 			break;
 	}
 }
@@ -321,106 +1850,284 @@ void SSD1306::setPixelInternal(uint8_t x, uint8_t y)
 
 void SSD1306::setVBarInternal(uint8_t x, uint8_t top, uint8_t bottom)
 {
-	uint16_t offset;
-	uint8_t pattern;
-	uint8_t i;
-	
-	uint8_t pageTop = (SSD1306_NUMPAGES-1) & (top >> 3);
-	uint8_t pageBottom = (SSD1306_NUMPAGES-1) & (bottom >> 3);
-	
-	uint8_t topPattern = 0xFF << (top & 0x07);
-	uint8_t bottomPattern = (0x02 << (bottom & 0x07)) - 1;
-	
-	if (pageTop == pageBottom) {
-		offset = x + pageTop * (uint16_t)SSD1306_WIDTH;
-		pattern = topPattern & bottomPattern;
-		switch (mode) {
-			case GL_BLACK:
-				display[offset] &= ~pattern;
-				break;
-			default:
-			case GL_WHITE:
-				display[offset] |= pattern;
-				break;
-			case GL_XOR:
-				display[offset] ^= pattern;
-				break;
-		}
-	} else {
-		offset = x + pageTop * (uint16_t)SSD1306_WIDTH;
-		switch (mode) {
-			case GL_BLACK:
-			display[offset] &= ~topPattern;
+	switch (mode) {
+		case GL_BLACK:
+			VBar<RopBlack>(display, x, top, bottom);
+			break;
+		default:
+		case GL_WHITE:
+			VBar<RopWhite>(display, x, top, bottom);
+			break;
+		case GL_XOR:
+			VBar<RopXor>(display, x, top, bottom);
+			break;
+	}
+}
+
+/*	SSD1306::fillRectInternal
+ *
+ *		Fill a rectangle. Right and bottom are inclusive, and the rectangle has
+ *	already been clipped to the display.
+ */
+
+void SSD1306::fillRectInternal(uint8_t left, uint8_t top, uint8_t right, uint8_t bottom)
+{
+	switch (mode) {
+		case GL_BLACK:
+			FillRect<RopBlack>(display, left, top, right, bottom);
+			break;
+		default:
+		case GL_WHITE:
+			FillRect<RopWhite>(display, left, top, right, bottom);
+			break;
+		case GL_XOR:
+			FillRect<RopXor>(display, left, top, right, bottom);
+			break;
+	}
+}
+
+/*
+ *	This is a little faster than calling setPixel for a row. Note that right is
+ *	inclusive, so left == right draws 1 pixel.
+ */
+
+void SSD1306::setHBarInternal(uint8_t left, uint8_t right, uint8_t y)
+{
+	switch (mode) {
+		case GL_BLACK:
+			HBar<RopBlack>(display, left, right, y);
+			break;
+		default:
+		case GL_WHITE:
+			HBar<RopWhite>(display, left, right, y);
+			break;
+		case GL_XOR:
+			HBar<RopXor>(display, left, right, y);
+			break;
+	}
+}
+
+/*	SSD1306::blitPages
+ *
+ *		Draw page organized data with the current drawing mode: set bits in
+ *	the data are drawn, clear bits leave the display unchanged.
+ */
+
+void SSD1306::blitPages(const uint8_t *data, uint8_t width, uint8_t pages, uint8_t x, uint8_t y)
+{
+	switch (mode) {
+		case GL_BLACK:
+			BlitPages<RopBlack>(display, data, width, pages, x, y);
 			break;
-			default:
-			case GL_WHITE:
-			display[offset] |= topPattern;
+		default:
+		case GL_WHITE:
+			BlitPages<RopWhite>(display, data, width, pages, x, y);
 			break;
-			case GL_XOR:
-			display[offset] ^= topPattern;
+		case GL_XOR:
+			BlitPages<RopXor>(display, data, width, pages, x, y);
 			break;
+	}
+}
+
+/*	UnpackGlyph
+ *
+ *		Convert the row-major bit packed glyph bits into page organized column
+ *	bytes, (height + 7) / 8 rows of width bytes.
+ */
+
+static void UnpackGlyph(const GFXfont *font, const GFXglyph *gdata, uint8_t *buffer)
+{
+	uint8_t width = gdata->width;
+	uint8_t pages = (gdata->height + 7) >> 3;
+	
+	memset(buffer,0,width * (uint16_t)pages);
+	
+	const uint8_t *bitmap = font->bitmap + gdata->bitmapOffset;
+	uint8_t bits = 0;
+	uint8_t mask = 0;
+	for (uint8_t r = 0; r < gdata->height; ++r) {
+		uint8_t *row = buffer + (r >> 3) * width;
+		uint8_t bit = 1 << (r & 0x07);
+		for (uint8_t c = 0; c < width; ++c) {
+			if (mask == 0) {
+				bits = *bitmap++;
+				mask = 0x80;
+			}
+			if (bits & mask) row[c] |= bit;
+			mask >>= 1;
 		}
+	}
+}
+
+/*	SSD1306::clearGlyphCache
+ *
+ *		Empty the glyph cache and reset the statistics
+ */
+
+void SSD1306::clearGlyphCache()
+{
+	cacheHits = 0;
+	cacheMisses = 0;
+#if SSD1306_GLYPHCACHE > 0
+	cacheClock = 0;
+	for (uint8_t i = 0; i < SSD1306_GLYPHCACHE; ++i) {
+		cache[i].glyph = NULL;
+		cache[i].used = 0;
+	}
+#endif
+}
+
+/*	SSD1306::drawGlyphInternal
+ *
+ *		Draw a glyph. If the font carries page organized data we use that
+ *	directly. Otherwise we look in the glyph cache, and on a miss the row-major
+ *	glyph bits are converted into page organized column bytes (and cached if
+ *	small enough). Either way the column bytes are then combined into display
+ *	memory a byte at a time.
+ */
 
-		offset = x + pageBottom * (uint16_t)SSD1306_WIDTH;
-		switch (mode) {
-			case GL_BLACK:
-				display[offset] &= ~bottomPattern;
-				break;
-			default:
-			case GL_WHITE:
-				display[offset] |= bottomPattern;
-				break;
-			case GL_XOR:
-				display[offset] ^= bottomPattern;
-				break;
+void SSD1306::drawGlyphInternal(const GFXglyph *gdata, uint8_t x, uint8_t y)
+{
+	uint8_t buffer[SSD1306_GLYPHBUF];
+	uint8_t width = gdata->width;
+	uint8_t pages = (gdata->height + 7) >> 3;
+	uint16_t size = width * (uint16_t)pages;
+	
+	if (size == 0) return;
+	
+	if (font->pageBitmap) {
+		const uint8_t *data = font->pageBitmap + font->pageOffset[gdata - font->glyph];
+		blitPages(data,width,pages,x,y);
+		return;
+	}
+	
+#if SSD1306_GLYPHCACHE > 0
+	if (size <= SSD1306_CACHEDATA) {
+		/*
+		 *	Find the glyph, or the least recently used entry. If the clock
+		 *	wraps we restart the timestamps; this only costs the ordering.
+		 */
+		
+		if (++cacheClock == 0) {
+			for (uint8_t i = 0; i < SSD1306_GLYPHCACHE; ++i) cache[i].used = 0;
+			cacheClock = 1;
 		}
 		
-		pattern = 0xFF;
-		for (i = pageTop + 1; i < pageBottom; ++i) {
-			offset = x + i * (uint16_t)SSD1306_WIDTH;
-			switch (mode) {
-				case GL_BLACK:
-					display[offset] &= ~pattern;
-					break;
-				default:
-					case GL_WHITE:
-					display[offset] |= pattern;
-				break;
-					case GL_XOR:
-					display[offset] ^= pattern;
-				break;
+		CachedGlyph *victim = cache;
+		for (uint8_t i = 0; i < SSD1306_GLYPHCACHE; ++i) {
+			CachedGlyph *e = cache + i;
+			if (e->glyph == gdata) {
+				++cacheHits;
+				e->used = cacheClock;
+				blitPages(e->data,width,pages,x,y);
+				return;
 			}
+			if (e->used < victim->used) victim = e;
 		}
+		
+		++cacheMisses;
+		UnpackGlyph(font,gdata,victim->data);
+		victim->glyph = gdata;
+		victim->used = cacheClock;
+		blitPages(victim->data,width,pages,x,y);
+		return;
+	}
+#endif
+	
+	if (size > sizeof(buffer)) {
+		GraphicDisplay::drawGlyphInternal(gdata,x,y);
+		return;
 	}
+	
+	/*
+	 *	Unpack the glyph bits into columns
+	 */
+	
+	UnpackGlyph(font,gdata,buffer);
+	blitPages(buffer,width,pages,x,y);
 }
 
-/*
- *	This is a little faster than calling setPixel for a row. Note that right is
- *	inclusive, so left == right draws 1 pixel.
+/*	SSD1306::drawBitmapInternal
+ *
+ *		Draw the src area of a bitmap, which has already been clipped to the
+ *	display, using the raster operation.
  */
 
-void SSD1306::setHBarInternal(uint8_t left, uint8_t right, uint8_t y)
+void SSD1306::drawBitmapInternal(uint8_t x, uint8_t y, const GDBitmap *bitmap, const GDBitmap *mask, GDRect src, uint8_t rop)
 {
-	uint8_t bit = 1 << (0x07 & y);
-	uint8_t page = (SSD1306_NUMPAGES-1) & (y >> 3);
-	uint8_t i;
+	switch (rop) {
+		default:
+		case GD_ROP_COPY:
+			DrawBitmap<BltCopy>(display, x, y, bitmap, mask, src);
+			break;
+		case GD_ROP_OR:
+			DrawBitmap<BltOr>(display, x, y, bitmap, mask, src);
+			break;
+		case GD_ROP_AND:
+			DrawBitmap<BltAnd>(display, x, y, bitmap, mask, src);
+			break;
+		case GD_ROP_XOR:
+			DrawBitmap<BltXor>(display, x, y, bitmap, mask, src);
+			break;
+	}
+}
+
+/*	SSD1306::copyBitsInternal
+ *
+ *		Copy the src rectangle to dst; both are on the display but may overlap.
+ *	If the move is a whole number of pages each row of pages is moved with
+ *	memmove. Otherwise each column is read as a 64-bit value, shifted and
+ *	merged into the destination column. Columns are visited in the order which
+ *	reads each source column before it is overwritten.
+ */
+
+bool SSD1306::copyBitsInternal(GDRect src, GDPoint dst)
+{
+	uint8_t width = src.size.width;
+	uint8_t height = src.size.height;
 	
-	uint16_t offset = left + page * (uint16_t)SSD1306_WIDTH;
-	i = left;
-	do {
-		switch (mode) {
-			case GL_BLACK:
-				display[offset] &= ~bit;
-				break;
-			default:
-			case GL_WHITE:
-				display[offset] |= bit;
-				break;
-			case GL_XOR:
-				display[offset] ^= bit;
-				break;
+	if (((src.origin.y | dst.y | height) & 0x07) == 0) {
+		uint8_t pages = height >> 3;
+		uint8_t *s = display + src.origin.x + (src.origin.y >> 3) * SSD1306_WIDTH;
+		uint8_t *d = display + dst.x + (dst.y >> 3) * SSD1306_WIDTH;
+		
+		if (d > s) {
+			s += (pages - 1) * SSD1306_WIDTH;
+			d += (pages - 1) * SSD1306_WIDTH;
+			for (uint8_t p = 0; p < pages; ++p, s -= SSD1306_WIDTH, d -= SSD1306_WIDTH) {
+				memmove(d,s,width);
+			}
+		} else {
+			for (uint8_t p = 0; p < pages; ++p, s += SSD1306_WIDTH, d += SSD1306_WIDTH) {
+				memmove(d,s,width);
+			}
+		}
+		return true;
+	}
+	
+	uint64_t mask = (height >= 64) ? ~(uint64_t)0 : (((uint64_t)1 << height) - 1);
+	mask <<= dst.y;
+	
+	bool reverse = dst.x > src.origin.x;
+	for (uint8_t i = 0; i < width; ++i) {
+		uint8_t c = reverse ? width - 1 - i : i;
+		uint8_t *s = display + src.origin.x + c;
+		uint8_t *d = display + dst.x + c;
+		uint64_t sv = 0;
+		uint64_t dv = 0;
+		uint8_t p;
+		
+		for (p = 0; p < SSD1306_NUMPAGES; ++p) {
+			sv |= (uint64_t)s[p * SSD1306_WIDTH] << (p * 8);
+			dv |= (uint64_t)d[p * SSD1306_WIDTH] << (p * 8);
 		}
 		
-		++offset;
-	} while (i++ < right);
+		sv = (sv >> src.origin.y) << dst.y;
+		dv = (dv & ~mask) | (sv & mask);
+		
+		for (p = 0; p < SSD1306_NUMPAGES; ++p) {
+			d[p * SSD1306_WIDTH] = (uint8_t)(dv >> (p * 8));
+		}
+	}
+	return true;
 }
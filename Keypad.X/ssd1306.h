@@ -10,6 +10,7 @@
 #define SSD1306_H_
 
 #include "display.h"
+#include "i2c.h"
 
 /****************************************************************************/
 /*																			*/
@@ -25,6 +26,83 @@
 
 #define SSD1306_MEMORY				1024		/* Total size of display buf */
 
+/*
+ *	Diff flushing. Changed bytes separated by no more than this many unchanged
+ *	bytes are sent as a single run, since starting a new run costs more than
+ *	resending a few bytes.
+ */
+
+#define SSD1306_DIFFGAP				6
+
+/*
+ *	A window is written as a single vectored I2C transaction: the 0x40 control
+ *	byte followed by a slice of display memory for each page.
+ */
+
+#define SSD1306_MAXSEGMENTS			9			/* Control byte + 8 pages */
+
+/*
+ *	Most windows a single asynchronous flush can send: each dirty region, split
+ *	in two around the pages being hardware scrolled.
+ */
+
+#define SSD1306_MAXWINDOWS			(GD_MAXDIRTY * 2)
+
+/*
+ *	Stream flushing. In diff mode, short runs are packed into a single I2C
+ *	transaction using the continuation bit of the control byte, so each costs
+ *	its window command and data (two bytes per byte) rather than a transaction
+ *	pair. The stream ends with the longest run, sent as plain data. Runs longer
+ *	than SSD1306_STREAMRUN bytes are cheaper on their own.
+ */
+
+#define SSD1306_MAXRUNS				32			/* Runs planned at a time */
+#define SSD1306_STREAMRUN			3			/* Longest run to pack */
+#define SSD1306_STREAMBUF			128			/* Stream buffer size */
+
+/*
+ *	Flush planning. Besides 9 bit times per byte and a start and stop per
+ *	transaction, each transaction is allowed SSD1306_TXNTIME microseconds for
+ *	the driver to finish one transfer and start the next and for the bus
+ *	free time. This is what makes fewer, larger transactions win at higher
+ *	bus speeds.
+ */
+
+#define SSD1306_TXNTIME				10			/* us per transaction */
+
+/*
+ *	Priority areas. Up to SSD1306_MAXAREAS areas of the display may be given a
+ *	priority; pages of dirty regions which overlap them are sent in priority
+ *	order.
+ */
+
+#define SSD1306_MAXAREAS			4
+
+/*
+ *	Largest glyph (width times pages) converted into column bytes when drawing
+ *	text. Larger glyphs are drawn a pixel at a time.
+ */
+
+#define SSD1306_GLYPHBUF			128
+
+/*
+ *	Glyph cache. For fonts without page organized data we keep the most
+ *	recently used glyphs already converted into column bytes, so redrawing the
+ *	same characters skips unpacking the bitmap. Glyphs larger than
+ *	SSD1306_CACHEDATA bytes are not cached. Fonts with page data (such as
+ *	smallfont) never use the cache, so it is off by default; set
+ *	SSD1306_GLYPHCACHE to the number of glyphs to cache to turn it on.
+ *
+ *	The cache is part of the SSD1306 class, so the value must be the same in
+ *	every file: define it in the project's preprocessor macros, never in a
+ *	source file. host/glyphtest.cpp is built with it set to 16.
+ */
+
+#ifndef SSD1306_GLYPHCACHE
+#define SSD1306_GLYPHCACHE			0			/* Number of cached glyphs */
+#endif
+#define SSD1306_CACHEDATA			16			/* Bytes per cached glyph */
+
 /****************************************************************************/
 /*																			*/
 /*	Constants																*/
@@ -32,12 +110,71 @@
 /****************************************************************************/
 
 /*
- *  Drawing modes
+ *  Hardware scroll directions. The diagonal directions also move the
+ *  vertical scroll area (see setScrollArea) up by the vertical offset each step
+ */
+
+#define SSD1306_SCROLL_RIGHT		0
+#define SSD1306_SCROLL_LEFT			1
+#define SSD1306_SCROLL_UPRIGHT		2
+#define SSD1306_SCROLL_UPLEFT		3
+
+/*
+ *  Hardware scroll step intervals, in frames. (The odd ordering is how the
+ *  controller encodes them.)
+ */
+
+#define SSD1306_SCROLL_2FRAMES		7
+#define SSD1306_SCROLL_3FRAMES		4
+#define SSD1306_SCROLL_4FRAMES		5
+#define SSD1306_SCROLL_5FRAMES		0
+#define SSD1306_SCROLL_25FRAMES		6
+#define SSD1306_SCROLL_64FRAMES		1
+#define SSD1306_SCROLL_128FRAMES	2
+#define SSD1306_SCROLL_256FRAMES	3
+
+/*
+ *  Flush strategies
+ */
+
+#define SSD1306_PLAN_DIFF			0			/* Changed runs only */
+#define SSD1306_PLAN_WINDOWS		1			/* Each dirty region's pages */
+#define SSD1306_PLAN_FULL			2			/* Whole display at once */
+
+/*
+ *  Priority classes. Pages outside any priority area are normal.
  */
 
-#define GL_BLACK       				0
-#define GL_WHITE       				1
-#define GL_XOR         				2
+#define SSD1306_PRIORITY_LOW		0
+#define SSD1306_PRIORITY_NORMAL		1
+#define SSD1306_PRIORITY_HIGH		2
+#define SSD1306_PRIORITIES			3
+
+/*  SSD1306Latency
+ *
+ *      Flush latency for a priority class: the time (in GetMilliseconds
+ *  units) from the first change in that class to it all being sent
+ */
+
+struct SSD1306Latency {
+    uint16_t                count;              /* Flushes measured */
+    uint32_t                total;              /* Sum of latencies */
+    uint32_t                max;
+    uint32_t                last;
+};
+
+/*  SSD1306Plan
+ *
+ *      How writeDisplay will send the dirty regions, and what that is
+ *  predicted to cost at the current bus speed
+ */
+
+struct SSD1306Plan {
+    uint8_t                 strategy;           /* SSD1306_PLAN_xxx */
+    uint16_t                bytes;              /* Including address bytes */
+    uint16_t                transactions;
+    uint32_t                micros;             /* Predicted time on the bus */
+};
 
 /****************************************************************************/
 /*																			*/
@@ -69,6 +206,66 @@ class SSD1306: public GraphicDisplay
                             
         void                clear();
         bool                writeDisplay();
+        uint16_t            dirtyCost();
+        
+        /*
+         *  Incremental flushing. writeDisplayStep sends about maxBytes of
+         *  the dirty regions (at least one page of one region) and removes
+         *  what it sent from them, so drawing can carry on between steps;
+         *  call it until dirtyRegionCount() is zero. writeDisplayFor steps
+         *  until everything is sent or GetMilliseconds() reaches deadline,
+         *  sizing each step by its predicted time on the bus.
+         *  Both return false on an I2C error, and do nothing while an
+         *  asynchronous flush is running.
+         */
+        
+        bool                writeDisplayStep(uint16_t maxBytes);
+        bool                writeDisplayFor(uint32_t deadline);
+        
+        /*
+         *  Flush priorities. setPriority gives an area of the display one of
+         *  the SSD1306_PRIORITY_xxx classes, so that writeDisplay and
+         *  writeDisplayStep send changes there before (or, for low
+         *  priority, after) everything else. Returns false if there are
+         *  already SSD1306_MAXAREAS areas. Where areas overlap the highest
+         *  priority wins. Priorities work in whole pages.
+         */
+        
+        bool                setPriority(GDRect r, uint8_t priority);
+        void                clearPriorities();
+        void                getLatency(uint8_t priority, SSD1306Latency &latency) const
+                                {
+                                    latency = latencyStats[priority];
+                                }
+        void                clearLatency();
+        
+        /*
+         *  Flush planning. writeDisplay estimates the cost of sending the
+         *  whole display, of sending each dirty region's pages, and (in diff
+         *  mode) of sending only the changed runs, and uses the cheapest.
+         *  flushPlan returns the plan for the current dirty regions;
+         *  lastPlan the plan the last writeDisplay used.
+         */
+        
+        SSD1306Plan         flushPlan();
+        const SSD1306Plan  &lastPlan() const
+                                {
+                                    return plan;
+                                }
+        
+        /*
+         *  Double buffering. swap copies the dirty pages into the front
+         *  buffer and starts sending them from the I2C interrupt, returning
+         *  immediately; drawing can continue in the back buffer while the
+         *  flush runs. swap returns false if the previous flush is still
+         *  running, in which case the changes stay dirty for the next swap.
+         */
+        
+        bool                swap();
+        bool                isFlushing() const
+                                {
+                                    return flushing;
+                                }
         
         /*
          *  SSD1306 specific routines
@@ -76,15 +273,65 @@ class SSD1306: public GraphicDisplay
         
 		bool                setContrast(uint8_t c);
 		bool                setDisplay(bool on);	/* turn display on or off */
+		bool                setStartLine(uint8_t line);
         void                setDrawingMode(uint8_t m)
                                 {
                                     mode = m;
                                 }
+        uint8_t             drawingMode() const
+                                {
+                                    return mode;
+                                }
+        
+        /*
+         *  Diff mode. When enabled we keep a shadow copy of what was last
+         *  sent to the device, and writeDisplay only sends the bytes within
+         *  the dirty regions that actually changed.
+         */
+        
+        void                setDiffMode(bool on);
+        
+        /*
+         *  Hardware scrolling. The controller scrolls the pages startPage
+         *  through endPage (inclusive) on its own, with no bus traffic per
+         *  step. It rewrites its own display memory as it goes, so while
+         *  scrolling writeDisplay leaves those pages alone; stopScroll
+         *  marks them dirty so the next writeDisplay restores them.
+         */
+        
+        bool                startScroll(uint8_t dir, uint8_t startPage, uint8_t endPage, uint8_t interval = SSD1306_SCROLL_5FRAMES, uint8_t vertical = 0);
+        bool                setScrollArea(uint8_t top, uint8_t rows);
+        bool                stopScroll();
+        bool                isScrolling() const
+                                {
+                                    return scrolling;
+                                }
+        
+        /*
+         *  Glyph cache statistics
+         */
+        
+        void                clearGlyphCache();
+        uint32_t            glyphCacheHits() const
+                                {
+                                    return cacheHits;
+                                }
+        uint32_t            glyphCacheMisses() const
+                                {
+                                    return cacheMisses;
+                                }
         
     protected:
         void                setPixelInternal(uint8_t x, uint8_t y);
         virtual void        setHBarInternal(uint8_t left, uint8_t right, uint8_t y);
         virtual void        setVBarInternal(uint8_t x, uint8_t top, uint8_t bottom);
+        virtual void        fillRectInternal(uint8_t left, uint8_t top, uint8_t right, uint8_t bottom);
+        virtual void        drawGlyphInternal(const GFXglyph *g, uint8_t x, uint8_t y);
+        virtual void        drawBitmapInternal(uint8_t x, uint8_t y, const GDBitmap *bitmap, const GDBitmap *mask, GDRect src, uint8_t rop);
+        virtual bool        copyBitsInternal(GDRect src, GDPoint dst);
+        virtual void        dirtyInternal(const GDRect &r);
+        
+        void                blitPages(const uint8_t *data, uint8_t width, uint8_t pages, uint8_t x, uint8_t y);
 
 		/*
 		 *	Raw display memory
@@ -92,8 +339,101 @@ class SSD1306: public GraphicDisplay
 		uint8_t             display[SSD1306_MEMORY];/* Display memory */	
 		
 	private:
+        struct Run {
+            uint8_t         page;
+            uint8_t         left,right;         /* Columns [left,right) */
+        };
+        
+        static void         FlushCallback(int8_t status, void *context);
+        static uint16_t     PlanStream(const Run *run, uint8_t count, uint8_t &last, uint32_t &mask);
+        bool                flushNext();
+        bool                writeSteps(uint16_t maxBytes, uint32_t maxMicros);
+        bool                writeArea(uint8_t top, uint8_t bottom, uint8_t left, uint8_t right, bool diff);
+        void                areaCost(SSD1306Plan &p, uint8_t top, uint8_t bottom, uint8_t left, uint8_t right, bool diff, uint8_t *sent = NULL);
+        bool                writePages(uint8_t top, uint8_t bottom, uint8_t left, uint8_t right, bool diff);
+        void                pagesCost(SSD1306Plan &p, uint8_t top, uint8_t bottom, uint8_t left, uint8_t right, bool diff, uint8_t *sent);
+        void                planCost(SSD1306Plan &p, uint8_t strategy);
+        static void         PlanTime(SSD1306Plan &p);
+        uint8_t             pageClass(uint8_t page, uint8_t left, uint8_t right);
+        bool                classDirty(uint8_t priority);
+        bool                writeClass(uint8_t priority, bool diff);
+        void                classCost(SSD1306Plan &p, uint8_t priority, bool diff, uint8_t *sent);
+        void                removePages(uint8_t i, uint8_t top, uint8_t bottom);
+        void                flushed(uint8_t priority);
+        bool                writeWindow(uint8_t top, uint8_t bottom, uint8_t left, uint8_t right);
+        bool                writeStream(const Run *run, uint8_t count, uint8_t last, uint32_t mask);
+        bool                writeRuns(const Run *run, uint8_t count);
+        void                runsCost(SSD1306Plan &p, const Run *run, uint8_t count);
+        bool                nextRun(uint8_t page, uint8_t &left, uint8_t &right, uint8_t end, const uint8_t *sent = NULL);
+
         uint8_t             address;
 		uint8_t             mode;
+        
+        bool                diffMode;
+        bool                shadowValid;
+        bool                shadowFilling;      /* Steps are resending all */
+        uint8_t             shadow[SSD1306_MEMORY];/* Last sent to device */
+        
+        uint8_t             startLine;
+        bool                scrolling;
+        bool                scrollVertical;
+        uint8_t             scrollTop;          /* Scrolled pages, [top,bottom) */
+        uint8_t             scrollBottom;
+        
+        SSD1306Plan         plan;               /* Last plan used */
+        
+        /*
+         *  Priority areas, in pages [top,bottom) and columns [left,right)
+         */
+        
+        struct PriorityArea {
+            uint8_t         top,bottom;
+            uint8_t         left,right;
+            uint8_t         priority;
+        };
+        
+        uint8_t             areaCount;
+        PriorityArea        area[SSD1306_MAXAREAS];
+        
+        uint8_t             latencyPending;     /* Bit per class with changes */
+        uint32_t            latencySince[SSD1306_PRIORITIES];
+        SSD1306Latency      latencyStats[SSD1306_PRIORITIES];
+        
+        /*
+         *  Asynchronous flush. The window list and front buffer are only
+         *  touched by the interrupt while flushing is set.
+         */
+        
+        struct FlushWindow {
+            uint8_t         top,bottom;         /* Pages [top,bottom) */
+            uint8_t         left,right;         /* Columns [left,right) */
+        };
+        
+        volatile bool       flushing;
+        volatile bool       flushFailed;
+        uint8_t             flushCount;
+        uint8_t             flushIndex;
+        FlushWindow         flushWindow[SSD1306_MAXWINDOWS];
+        uint8_t             flushCommand[7];
+        TWISegment          flushSegment[SSD1306_MAXSEGMENTS];
+        uint8_t             front[SSD1306_MEMORY];/* Being sent to device */
+        
+        /*
+         *  Glyph cache
+         */
+        
+        struct CachedGlyph {
+            const GFXglyph  *glyph;             /* NULL if unused */
+            uint16_t        used;               /* LRU timestamp */
+            uint8_t         data[SSD1306_CACHEDATA];
+        };
+        
+        uint32_t            cacheHits;
+        uint32_t            cacheMisses;
+#if SSD1306_GLYPHCACHE > 0
+        uint16_t            cacheClock;
+        CachedGlyph         cache[SSD1306_GLYPHCACHE];
+#endif
 };
 
 
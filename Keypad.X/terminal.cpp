@@ -0,0 +1,171 @@
+/*  terminal.cpp
+ *
+ *      Scrolling text terminal using the SSD1306 start line register
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "terminal.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Construction/Destruction												*/
+/*																			*/
+/****************************************************************************/
+
+/*  Terminal::Terminal
+ *
+ *      Construction
+ */
+
+Terminal::Terminal(SSD1306 &d) : display(d)
+{
+    font = NULL;
+    top = 0;
+    row = 0;
+    xpos = 0;
+    rotated = false;
+}
+
+/*  Terminal::~Terminal
+ *
+ *      Destruction
+ */
+
+Terminal::~Terminal()
+{
+}
+
+/*  Terminal::start
+ *
+ *      Clear the display and reset the start line. The display must already
+ *  have been started.
+ */
+
+void Terminal::start(const GFXfont *f)
+{
+    font = f;
+    top = 0;
+    row = 0;
+    xpos = 0;
+    rotated = true;
+    
+    GDRect clip = display.clipRect();
+    display.clearClipRect();
+    display.clear();
+    display.setClipRect(clip);
+}
+
+/****************************************************************************/
+/*																			*/
+/*	Output      															*/
+/*																			*/
+/****************************************************************************/
+
+/*  Terminal::clearRow
+ *
+ *      Erase the page holding the row. The display may be shared with other
+ *  drawing, so the caller's drawing mode and clip rectangle are put back.
+ */
+
+void Terminal::clearRow(uint8_t r)
+{
+    GDRect clip = display.clipRect();
+    uint8_t mode = display.drawingMode();
+    
+    display.clearClipRect();
+    display.setDrawingMode(GL_BLACK);
+    display.paintRect((GDRect){ 0, (uint8_t)(page(r) * 8), 128, 8 });
+    display.setDrawingMode(mode);
+    display.setClipRect(clip);
+}
+
+/*  Terminal::newLine
+ *
+ *      Move to the start of the next line. On the last line we scroll by
+ *  rotating the ring of pages: the old top page is cleared and becomes the
+ *  new bottom line.
+ */
+
+void Terminal::newLine()
+{
+    xpos = 0;
+    if (row < TERMINAL_ROWS - 1) {
+        ++row;
+    } else {
+        top = (top + 1) & (TERMINAL_ROWS - 1);
+        rotated = true;
+        clearRow(row);
+    }
+}
+
+/*  Terminal::putChar
+ *
+ *      Write a character, wrapping at the right edge. Drawing is clipped to
+ *  the cursor's page, so nothing spills into the neighboring lines. As with
+ *  clearRow, the caller's font, drawing mode and clip rectangle are put back.
+ */
+
+void Terminal::putChar(char c)
+{
+    if (c == '\n') {
+        newLine();
+        return;
+    }
+    if (c == '\r') {
+        xpos = 0;
+        return;
+    }
+    
+    const GFXfont *oldFont = display.currentFont();
+    display.setFont(font);
+    uint8_t w = display.width((uint16_t)c);
+    if (w == 0) {
+        display.setFont(oldFont);
+        return;
+    }
+    if (xpos + w > 128) newLine();
+    
+    GDRect clip = display.clipRect();
+    uint8_t mode = display.drawingMode();
+    uint8_t y = page(row) * 8;
+    
+    display.setClipRect((GDRect){ 0, y, 128, 8 });
+    display.setDrawingMode(GL_WHITE);
+    display.moveTo((GDPoint){ xpos, (uint8_t)(y + TERMINAL_BASELINE) });
+    display.drawChar(c);
+    display.setDrawingMode(mode);
+    display.setClipRect(clip);
+    display.setFont(oldFont);
+    
+    xpos += w;
+}
+
+/*  Terminal::print
+ *
+ *      Write a string
+ */
+
+void Terminal::print(const char *str)
+{
+    char c;
+    
+    while (0 != (c = *str++)) putChar(c);
+}
+
+/*  Terminal::flush
+ *
+ *      Send the changes to the display. The new page contents are written
+ *  before the start line is rotated, so a new line appears complete.
+ */
+
+bool Terminal::flush()
+{
+    if (!display.writeDisplay()) return false;
+    
+    if (rotated) {
+        if (!display.setStartLine(top * 8)) return false;
+        rotated = false;
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+/*  terminal.h
+ *
+ *      A scrolling text terminal on the SSD1306. Each line of text is one page
+ *  of display memory, and the eight pages are treated as a ring: scrolling
+ *  rotates the display start line rather than moving display memory, so a
+ *  new line costs one page write and one command.
+ */
+
+#ifndef _TERMINAL_H
+#define _TERMINAL_H
+
+#include <stdint.h>
+#include "ssd1306.h"
+
+/****************************************************************************/
+/*																			*/
+/*	Constants   															*/
+/*																			*/
+/****************************************************************************/
+
+#define TERMINAL_ROWS           8           /* One row per display page */
+#define TERMINAL_BASELINE       7           /* Font baseline within a page */
+
+/****************************************************************************/
+/*																			*/
+/*	Class Declaration     													*/
+/*																			*/
+/****************************************************************************/
+
+/*  Terminal
+ *
+ *      Text terminal. The font must fit in a single 8 pixel page with its
+ *  baseline at TERMINAL_BASELINE, as smallfont does. Output leaves the
+ *  display's font, drawing mode and clip rectangle as it found them, so
+ *  other code can draw on the same display.
+ */
+
+class Terminal
+{
+    public:
+                            Terminal(SSD1306 &display);
+                            ~Terminal();
+                            
+        void                start(const GFXfont *font);
+        
+        void                putChar(char c);
+        void                print(const char *str);
+        void                newLine();
+        
+        bool                flush();
+        
+    private:
+        void                clearRow(uint8_t row);
+        uint8_t             page(uint8_t row)
+                                {
+                                    return (top + row) & (TERMINAL_ROWS - 1);
+                                }
+        
+        SSD1306             &display;
+        const GFXfont       *font;
+        
+        uint8_t             top;            /* Page shown at top of screen */
+        uint8_t             row;            /* Cursor row, 0 at top */
+        uint8_t             xpos;           /* Cursor x position */
+        bool                rotated;        /* Start line needs to be sent */
+};
+
+#endif /* _TERMINAL_H */